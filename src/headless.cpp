@@ -0,0 +1,175 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+#include <cstring>
+#include <memory>
+
+#include "model/gridexporter.h"
+#include "model/gridmodel.h"
+#include "model/pathfinder.h"
+#include "model/queryservice.h"
+
+#include "headless.h"
+
+namespace {
+
+constexpr double DEFAULT_WALL_PROBABILITY = 0.3;
+
+QTextStream &err() {
+    static QTextStream stream(stderr);
+    return stream;
+}
+
+// "W,H" или "X1,Y1,X2,Y2" -> числа; false, если формат не тот
+bool parseNumbers(const QString &text, int count, std::vector<int> &numbers) {
+    const QStringList parts = text.split(',');
+    if (parts.size() != count)
+        return false;
+
+    numbers.clear();
+    for (const auto &part : parts) {
+        bool ok = false;
+        numbers.push_back(part.trimmed().toInt(&ok));
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+bool loadModel(const QCommandLineParser &parser, GridModel &model) {
+    if (parser.isSet("world")) {
+        if (!model.loadWorld(parser.value("world"))) {
+            err() << "Не удалось открыть мир " << parser.value("world") << Qt::endl;
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<int> size;
+    if (!parser.isSet("random") || !parseNumbers(parser.value("random"), 2, size)) {
+        err() << "Нужен --world <файл> или --random <ширина,высота>" << Qt::endl;
+        return false;
+    }
+
+    model.initialize(size[0], size[1]);
+    if (model.width() != size[0] || model.height() != size[1]) {
+        err() << "Недопустимый размер карты" << Qt::endl;
+        return false;
+    }
+    model.generateRandomWalls(DEFAULT_WALL_PROBABILITY);
+    return true;
+}
+
+int runExport(const QCommandLineParser &parser) {
+    GridModel model;
+    if (!loadModel(parser, model))
+        return 1;
+
+    GridExporter exporter(&model);
+    if (parser.isSet("cell-size"))
+        exporter.setCellSize(parser.value("cell-size").toInt());
+    if (parser.isSet("tile-size"))
+        exporter.setTileSize(parser.value("tile-size").toInt());
+
+    std::unique_ptr<PathFinder> pathFinder;
+    if (parser.isSet("path") || parser.isSet("flow"))
+        pathFinder = std::make_unique<PathFinder>(&model);
+
+    if (parser.isSet("path")) {
+        std::vector<int> points;
+        if (!parseNumbers(parser.value("path"), 4, points)) {
+            err() << "--path ожидает X1,Y1,X2,Y2" << Qt::endl;
+            return 1;
+        }
+
+        PathPtr path = pathFinder->findPathAsync(QPoint(points[0], points[1]),
+                                                 QPoint(points[2], points[3])).result();
+        if (!path)
+            err() << "Путь не найден, экспортируется только карта" << Qt::endl;
+        exporter.addPath(std::move(path));
+    }
+
+    if (parser.isSet("flow")) {
+        std::vector<int> goal;
+        if (!parseNumbers(parser.value("flow"), 2, goal)) {
+            err() << "--flow ожидает X,Y" << Qt::endl;
+            return 1;
+        }
+
+        FlowFieldPtr field = pathFinder->flowFieldAsync(QPoint(goal[0], goal[1])).result();
+        if (!field)
+            err() << "Точка --flow недопустима, область не подсвечивается" << Qt::endl;
+        exporter.setReachable(std::move(field));
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!exporter.exportTiles(parser.value("export"))) {
+        err() << "Не удалось записать плитки в " << parser.value("export") << Qt::endl;
+        return 1;
+    }
+
+    err() << "Экспорт " << model.width() << "x" << model.height() << " за "
+          << timer.elapsed() << " мс" << Qt::endl;
+    return 0;
+}
+
+int runService(QCoreApplication &app, const QCommandLineParser &parser) {
+    GridModel model;
+    if (!loadModel(parser, model))
+        return 1;
+
+    PathFinder pathFinder(&model);
+    if (parser.isSet("flow-cache"))
+        pathFinder.setFlowFieldCacheSize(parser.value("flow-cache").toInt());
+
+    QueryService service(&model, &pathFinder);
+    if (!service.listen(parser.value("serve")))
+        return 1;
+
+    err() << "Карта " << model.width() << "x" << model.height() << ", служба "
+          << service.fullServerName() << Qt::endl;
+    return app.exec();
+}
+
+} // namespace
+
+namespace Headless {
+
+bool requested(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--export") == 0 || std::strcmp(argv[i], "--serve") == 0)
+            return true;
+    }
+    return false;
+}
+
+int run(QCoreApplication &app) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Path Finder, пакетный режим");
+    parser.addHelpOption();
+    parser.addOptions({
+        { "export", "Экспорт карты в плитки PNG и index.json в <каталог>.", "каталог" },
+        { "serve", "Служба запросов путей по локальному сокету <имя>.", "имя" },
+        { "world", "Файл мира (GridModel::saveWorld).", "файл" },
+        { "random", "Случайная карта вместо файла мира.", "ширина,высота" },
+        { "path", "Наложить кратчайший путь между точками.", "x1,y1,x2,y2" },
+        { "flow", "Подсветить клетки, из которых достижима точка.", "x,y" },
+        { "flow-cache", "Полей направлений в кэше службы.", "число" },
+        { "cell-size", "Сторона клетки в пикселях.", "пиксели" },
+        { "tile-size", "Сторона плитки в пикселях.", "пиксели" },
+    });
+    parser.process(app);
+
+    if (parser.isSet("export"))
+        return runExport(parser);
+    if (parser.isSet("serve"))
+        return runService(app, parser);
+
+    parser.showHelp(1);
+}
+
+} // namespace Headless
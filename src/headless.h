@@ -0,0 +1,16 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+class QCoreApplication;
+
+// Пакетный режим без окна и без дисплея, для скриптов и серверов.
+// Включается ключом в командной строке (см. requested), остальное
+// разбирает run.
+namespace Headless {
+
+bool requested(int argc, char *argv[]);
+int run(QCoreApplication &app);
+
+} // namespace Headless
+
+#endif // HEADLESS_H
@@ -1,16 +1,34 @@
 #include <QApplication>
 #include <QTranslator>
 #include <QLocale>
+#include <QThread>
 
+#include "headless.h"
 #include "mainwindow.h"
 
+namespace {
+
+void describeApplication() {
+    QCoreApplication::setApplicationName("PathFinder");
+    QCoreApplication::setApplicationVersion("1.0.0");
+    QCoreApplication::setOrganizationName("ProSoft");
+}
+
+} // namespace
+
 int main(int argc, char *argv[])
 {
+    // Пакетный режим обходится без QApplication и дисплея
+    if (Headless::requested(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        describeApplication();
+        return Headless::run(app);
+    }
+
     QApplication app(argc, argv);
+    describeApplication();
 
-    app.setApplicationName("PathFinder");
-    app.setApplicationVersion("1.0.0");
-    app.setOrganizationName("ProSoft");
+    QThread::currentThread()->setObjectName("GUI");
 
     MainWindow window;
     window.show();
@@ -0,0 +1,25 @@
+#include "cancellationtoken.h"
+
+CancellationToken::CancellationToken()
+    : m_state(std::make_shared<State>()) {
+}
+
+CancellationToken CancellationToken::withTimeout(int timeout_ms) {
+    CancellationToken token;
+    token.setDeadline(QDeadlineTimer(timeout_ms));
+    return token;
+}
+
+void CancellationToken::cancel() {
+    m_state->cancelled.store(true, std::memory_order_relaxed);
+}
+
+void CancellationToken::setDeadline(const QDeadlineTimer &deadline) {
+    // Срок задается до передачи токена в запрос, дальше только читается
+    m_state->deadline = deadline;
+}
+
+bool CancellationToken::isCancelled() const {
+    return m_state->cancelled.load(std::memory_order_relaxed) ||
+           m_state->deadline.hasExpired();
+}
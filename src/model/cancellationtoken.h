@@ -0,0 +1,33 @@
+#ifndef CANCELLATIONTOKEN_H
+#define CANCELLATIONTOKEN_H
+
+#include <QDeadlineTimer>
+
+#include <atomic>
+#include <memory>
+
+// Токен отмены запроса. Копии токена разделяют одно состояние, так что
+// вызывающий оставляет копию у себя и отменяет запрос из любого потока.
+// Срок (deadline) работает как отложенная отмена.
+class CancellationToken final {
+
+public:
+    CancellationToken();
+
+    static CancellationToken withTimeout(int timeout_ms);
+
+    void cancel();
+    void setDeadline(const QDeadlineTimer &deadline);
+
+    bool isCancelled() const;
+
+private:
+    struct State {
+        std::atomic<bool> cancelled { false };
+        QDeadlineTimer deadline { QDeadlineTimer::Forever };
+    };
+
+    std::shared_ptr<State> m_state;
+};
+
+#endif // CANCELLATIONTOKEN_H
@@ -0,0 +1,15 @@
+#ifndef CELLTYPE_H
+#define CELLTYPE_H
+
+#include <cstdint>
+
+enum class CellType : uint8_t {
+    Empty,
+    Wall,
+    Start,
+    End,
+    Path,
+    Visited
+};
+
+#endif // CELLTYPE_H
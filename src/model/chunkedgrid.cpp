@@ -0,0 +1,471 @@
+#include <QDebug>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QSaveFile>
+#include <QTemporaryFile>
+#include <QtEndian>
+
+#include <algorithm>
+
+#include "chunkedgrid.h"
+
+namespace {
+
+constexpr quint32 FILE_MAGIC = 0x50465744; // "PFWD"
+constexpr quint16 FILE_VERSION = 2;
+constexpr qint64 HEADER_BYTES = 24;
+// Область данных выравнивается по странице
+constexpr qint64 DATA_ALIGNMENT_bytes = 4096;
+
+} // namespace
+
+ChunkedGrid::Cursor::Cursor(const ChunkedGrid &grid)
+    : m_grid(&grid) {
+
+    // Курсоры создаются и в потоках пула, пока карта может пересоздаваться
+    QMutexLocker locker(&grid.m_mutex);
+    m_layout = grid.m_layout;
+    m_width = grid.m_width;
+    m_height = grid.m_height;
+    m_chunksX = grid.m_chunksX;
+}
+
+size_t ChunkedGrid::Cursor::pinnedChunks() const {
+    return m_pinned.size();
+}
+
+void ChunkedGrid::Cursor::select(int index) {
+    auto it = m_pinned.find(index);
+
+    if (it == m_pinned.end()) {
+        QMutexLocker locker(&m_grid->m_mutex);
+
+        Pinned pinned;
+        if (m_grid->m_layout != m_layout) {
+            // Карту пересоздали: блоки старой не сохранились, а индекс
+            // может выйти за новый каталог
+            pinned.value = static_cast<uint8_t>(CellType::Wall);
+        } else {
+            pinned.value = m_grid->m_slots[index].value;
+            if (pinned.value == DENSE_MARK)
+                pinned.data = m_grid->residentChunk(index);
+        }
+
+        it = m_pinned.emplace(index, std::move(pinned)).first;
+    }
+
+    m_lastIndex = index;
+    m_data = it->second.data ? it->second.data->data() : nullptr;
+    m_value = it->second.value;
+}
+
+ChunkedGrid::ChunkedGrid() = default;
+
+ChunkedGrid::~ChunkedGrid() = default;
+
+void ChunkedGrid::reset(int width, int height, CellType fill) {
+    QMutexLocker locker(&m_mutex);
+
+    ++m_layout;
+    m_width = width;
+    m_height = height;
+    m_chunksX = (width + CHUNK_MASK) >> CHUNK_SHIFT;
+    m_chunksY = (height + CHUNK_MASK) >> CHUNK_SHIFT;
+
+    Slot uniform;
+    uniform.value = static_cast<uint8_t>(fill);
+    m_slots.assign(static_cast<size_t>(m_chunksX) * m_chunksY, uniform);
+
+    resetStorage();
+    m_file.reset();
+    m_stamp = 0;
+}
+
+int ChunkedGrid::width() const {
+    QMutexLocker locker(&m_mutex);
+    return m_width;
+}
+
+int ChunkedGrid::height() const {
+    QMutexLocker locker(&m_mutex);
+    return m_height;
+}
+
+int ChunkedGrid::chunksX() const {
+    return m_chunksX;
+}
+
+int ChunkedGrid::chunksY() const {
+    return m_chunksY;
+}
+
+int ChunkedGrid::chunkIndex(int x, int y) const {
+    return (y >> CHUNK_SHIFT) * m_chunksX + (x >> CHUNK_SHIFT);
+}
+
+CellType ChunkedGrid::cell(int x, int y) const {
+    // Границы - под блокировкой: reset/open в потоке модели меняют их
+    // вместе с каталогом блоков
+    QMutexLocker locker(&m_mutex);
+
+    if (x < 0 || x >= m_width || y < 0 || y >= m_height)
+        return CellType::Wall;
+
+    int index = chunkIndex(x, y);
+    const Slot &slot = m_slots[index];
+    if (slot.value != DENSE_MARK)
+        return static_cast<CellType>(slot.value);
+
+    const auto &data = residentChunk(index);
+    return static_cast<CellType>((*data)[((y & CHUNK_MASK) << CHUNK_SHIFT) | (x & CHUNK_MASK)]);
+}
+
+void ChunkedGrid::setCell(int x, int y, CellType type) {
+    QMutexLocker locker(&m_mutex);
+
+    if (x < 0 || x >= m_width || y < 0 || y >= m_height)
+        return;
+
+    int index = chunkIndex(x, y);
+    int local = ((y & CHUNK_MASK) << CHUNK_SHIFT) | (x & CHUNK_MASK);
+    uint8_t value = static_cast<uint8_t>(type);
+    Slot &slot = m_slots[index];
+
+    if (slot.value == value)
+        return;
+
+    if (slot.value != DENSE_MARK) {
+        // Первое отличие в однородном блоке - разворачиваем его в память
+        slot.data = std::make_shared<ChunkData>(CHUNK_CELLS, slot.value);
+        slot.value = DENSE_MARK;
+        slot.inWorld = false;
+        slot.inSwap = false;
+        (*slot.data)[local] = value;
+
+        touch(index);
+        evictExcess();
+        return;
+    }
+
+    // Блок закреплен курсорами, которые читают его без блокировки, -
+    // правка идет в копию, курсоры дочитывают прежнюю версию
+    const std::shared_ptr<ChunkData> &data = residentChunk(index);
+    if (data.use_count() > 1)
+        slot.data = std::make_shared<ChunkData>(*data);
+
+    (*slot.data)[local] = value;
+    slot.inWorld = false;
+    slot.inSwap = false;
+}
+
+void ChunkedGrid::storeChunk(int chunkX, int chunkY, ChunkData data) {
+    if (data.size() != CHUNK_CELLS || chunkX < 0 || chunkX >= m_chunksX ||
+        chunkY < 0 || chunkY >= m_chunksY)
+        return;
+
+    bool uniform = std::all_of(data.begin(), data.end(),
+                               [first = data.front()](uint8_t value) { return value == first; });
+
+    QMutexLocker locker(&m_mutex);
+
+    int index = chunkY * m_chunksX + chunkX;
+    Slot &slot = m_slots[index];
+
+    auto position = m_lruPositions.find(index);
+    if (position != m_lruPositions.end()) {
+        m_lru.erase(position->second);
+        m_lruPositions.erase(position);
+    }
+
+    slot.inWorld = false;
+    slot.inSwap = false;
+    if (uniform) {
+        slot.data.reset();
+        slot.value = data.front();
+        return;
+    }
+
+    slot.data = std::make_shared<ChunkData>(std::move(data));
+    slot.value = DENSE_MARK;
+
+    touch(index);
+    evictExcess();
+}
+
+bool ChunkedGrid::save(const QString &path) {
+    // Под блокировкой - только снимок каталога и закрепление блоков в памяти:
+    // закрепленный блок не меняется, правка идет в его копию. Запись идет
+    // без блокировки, курсоры поиска ее не ждут
+    quint64 layout;
+    int width;
+    int height;
+    QByteArray directory;
+    std::vector<std::shared_ptr<const ChunkData>> pinned;
+    {
+        QMutexLocker locker(&m_mutex);
+
+        layout = m_layout;
+        width = m_width;
+        height = m_height;
+        directory.resize(static_cast<qsizetype>(m_slots.size()));
+        pinned.resize(m_slots.size());
+        for (size_t i = 0; i < m_slots.size(); ++i) {
+            directory[i] = static_cast<char>(m_slots[i].value);
+            if (m_slots[i].value == DENSE_MARK)
+                pinned[i] = m_slots[i].data;
+        }
+    }
+
+    // Мир пишется целиком во временный файл и подменяет прежний только после
+    // полной записи: сбой посреди сохранения не портит файл на диске
+    const quint64 stamp = QRandomGenerator::global()->generate64();
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || !writeHeader(file, width, height, stamp, directory))
+        return false;
+
+    const qint64 base = dataOffset(pinned.size());
+    ChunkData buffer;
+    for (size_t i = 0; i < pinned.size(); ++i) {
+        if (static_cast<uint8_t>(directory[i]) != DENSE_MARK)
+            continue;
+
+        const ChunkData *data = pinned[i].get();
+        if (!data) {
+            // Выгруженный блок переносим из подкачки или прежнего файла,
+            // не поднимая в LRU; их файлы делятся с курсорами - под блокировкой
+            QMutexLocker locker(&m_mutex);
+            if (m_layout != layout || !loadChunk(static_cast<int>(i), buffer))
+                return false;
+            data = &buffer;
+        }
+
+        if (!writeChunk(file, base + static_cast<qint64>(i) * CHUNK_CELLS, *data))
+            return false;
+        pinned[i].reset();
+    }
+
+    // Подмена файла и пометки блоков - вместе, чтобы курсоры не застали
+    // закрытый файл мира
+    QMutexLocker locker(&m_mutex);
+
+    // Карта сменилась во время записи - файл уже не про нее
+    if (m_layout != layout)
+        return false;
+
+    // Открытый файл мира не везде можно подменить - закрываем его до commit
+    bool sameFile = m_file && m_file->fileName() == path;
+    if (sameFile)
+        m_file->close();
+
+    if (!file.commit()) {
+        // Прежний файл остался на месте
+        if (sameFile && !m_file->open(QIODevice::ReadOnly))
+            qWarning() << "ChunkedGrid: не удалось переоткрыть" << path;
+        return false;
+    }
+
+    auto world = std::make_unique<QFile>(path);
+    if (!world->open(QIODevice::ReadOnly)) {
+        qWarning() << "ChunkedGrid: не удалось открыть сохраненный мир" << path;
+        return false;
+    }
+
+    // Правки идут в том же потоке, что и save, - за время записи блоки
+    // не менялись
+    for (auto &slot : m_slots) {
+        if (slot.value == DENSE_MARK) {
+            slot.inWorld = true;
+            slot.inSwap = false;
+        }
+    }
+
+    m_file = std::move(world);
+    m_stamp = stamp;
+    return true;
+}
+
+bool ChunkedGrid::open(const QString &path, int maxWidth, int maxHeight) {
+    auto file = std::make_unique<QFile>(path);
+    if (!file->open(QIODevice::ReadOnly))
+        return false;
+
+    QByteArray header = file->read(HEADER_BYTES);
+    if (header.size() != HEADER_BYTES)
+        return false;
+
+    const uchar *raw = reinterpret_cast<const uchar *>(header.constData());
+    quint32 magic = qFromLittleEndian<quint32>(raw);
+    quint16 version = qFromLittleEndian<quint16>(raw + 4);
+    quint16 shift = qFromLittleEndian<quint16>(raw + 6);
+    qint32 width = qFromLittleEndian<qint32>(raw + 8);
+    qint32 height = qFromLittleEndian<qint32>(raw + 12);
+    quint64 stamp = qFromLittleEndian<quint64>(raw + 16);
+
+    // Размер карты ограничен до выделения каталога: индексы клеток в поиске -
+    // int, и размер каталога не должен задаваться файлом
+    if (magic != FILE_MAGIC || version != FILE_VERSION || shift != CHUNK_SHIFT ||
+        width <= 0 || height <= 0 || width > maxWidth || height > maxHeight)
+        return false;
+
+    int chunksX = (width + CHUNK_MASK) >> CHUNK_SHIFT;
+    int chunksY = (height + CHUNK_MASK) >> CHUNK_SHIFT;
+    qint64 count = static_cast<qint64>(chunksX) * chunksY;
+
+    QByteArray directory = file->read(count);
+    if (directory.size() != count)
+        return false;
+
+    for (char value : directory) {
+        uint8_t cell = static_cast<uint8_t>(value);
+        if (cell != DENSE_MARK && cell > static_cast<uint8_t>(CellType::Visited))
+            return false;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    ++m_layout;
+    m_width = width;
+    m_height = height;
+    m_chunksX = chunksX;
+    m_chunksY = chunksY;
+
+    m_slots.assign(count, Slot());
+    for (qint64 i = 0; i < count; ++i) {
+        m_slots[i].value = static_cast<uint8_t>(directory[i]);
+        m_slots[i].inWorld = m_slots[i].value == DENSE_MARK;
+    }
+
+    resetStorage();
+    m_file = std::move(file);
+    m_stamp = stamp;
+    return true;
+}
+
+void ChunkedGrid::setResidentLimit(size_t chunks) {
+    QMutexLocker locker(&m_mutex);
+
+    m_residentLimit = std::max<size_t>(1, chunks);
+    evictExcess();
+}
+
+size_t ChunkedGrid::residentChunks() const {
+    QMutexLocker locker(&m_mutex);
+    return m_lru.size();
+}
+
+quint64 ChunkedGrid::stamp() const {
+    QMutexLocker locker(&m_mutex);
+    return m_stamp;
+}
+
+const std::shared_ptr<ChunkedGrid::ChunkData> &ChunkedGrid::residentChunk(int index) const {
+    Slot &slot = m_slots[index];
+
+    if (!slot.data) {
+        slot.data = std::make_shared<ChunkData>();
+        if (!loadChunk(index, *slot.data)) {
+            qWarning() << "ChunkedGrid: не удалось прочитать блок" << index;
+            slot.data->assign(CHUNK_CELLS, static_cast<uint8_t>(CellType::Wall));
+        }
+    }
+
+    // Только что поднятый блок стоит в голове LRU и вытеснен не будет
+    touch(index);
+    evictExcess();
+    return slot.data;
+}
+
+void ChunkedGrid::touch(int index) const {
+    auto position = m_lruPositions.find(index);
+    if (position != m_lruPositions.end()) {
+        m_lru.splice(m_lru.begin(), m_lru, position->second);
+        return;
+    }
+
+    m_lru.push_front(index);
+    m_lruPositions.emplace(index, m_lru.begin());
+}
+
+void ChunkedGrid::evictExcess() const {
+    while (m_lru.size() > m_residentLimit) {
+        int index = m_lru.back();
+        Slot &slot = m_slots[index];
+
+        // Измененный блок уходит в подкачку: файл мира меняет только save
+        if (!slot.inWorld && !slot.inSwap) {
+            if (!ensureSwap() ||
+                !writeChunk(*m_swap, static_cast<qint64>(index) * CHUNK_CELLS, *slot.data)) {
+                qWarning() << "ChunkedGrid: не удалось выгрузить блок" << index;
+                return;
+            }
+            slot.inSwap = true;
+        }
+
+        // Курсоры поиска могут держать копию указателя - память освободится
+        // после завершения их запросов
+        slot.data.reset();
+        m_lruPositions.erase(index);
+        m_lru.pop_back();
+    }
+}
+
+void ChunkedGrid::resetStorage() {
+    m_lru.clear();
+    m_lruPositions.clear();
+    // Подкачка относится к прежней карте
+    m_swap.reset();
+}
+
+bool ChunkedGrid::ensureSwap() const {
+    if (m_swap)
+        return true;
+
+    auto file = std::make_unique<QTemporaryFile>();
+    if (!file->open())
+        return false;
+
+    m_swap = std::move(file);
+    return true;
+}
+
+bool ChunkedGrid::writeHeader(QFileDevice &file, int width, int height, quint64 stamp,
+                              const QByteArray &directory) {
+    uchar header[HEADER_BYTES];
+    qToLittleEndian<quint32>(FILE_MAGIC, header);
+    qToLittleEndian<quint16>(FILE_VERSION, header + 4);
+    qToLittleEndian<quint16>(CHUNK_SHIFT, header + 6);
+    qToLittleEndian<qint32>(width, header + 8);
+    qToLittleEndian<qint32>(height, header + 12);
+    qToLittleEndian<quint64>(stamp, header + 16);
+
+    return file.seek(0) &&
+           file.write(reinterpret_cast<const char *>(header), HEADER_BYTES) == HEADER_BYTES &&
+           file.write(directory) == directory.size();
+}
+
+bool ChunkedGrid::writeChunk(QFileDevice &file, qint64 offset, const ChunkData &data) {
+    return file.seek(offset) &&
+           file.write(reinterpret_cast<const char *>(data.data()), CHUNK_CELLS) == CHUNK_CELLS;
+}
+
+bool ChunkedGrid::readChunk(QFile &file, qint64 offset, ChunkData &data) const {
+    data.resize(CHUNK_CELLS);
+    return file.seek(offset) &&
+           file.read(reinterpret_cast<char *>(data.data()), CHUNK_CELLS) == CHUNK_CELLS;
+}
+
+bool ChunkedGrid::loadChunk(int index, ChunkData &data) const {
+    const Slot &slot = m_slots[index];
+    if (slot.inSwap)
+        return m_swap && readChunk(*m_swap, static_cast<qint64>(index) * CHUNK_CELLS, data);
+    return slot.inWorld && m_file && readChunk(*m_file, worldOffset(index), data);
+}
+
+qint64 ChunkedGrid::worldOffset(int index) const {
+    return dataOffset(m_slots.size()) + static_cast<qint64>(index) * CHUNK_CELLS;
+}
+
+qint64 ChunkedGrid::dataOffset(size_t chunks) {
+    qint64 end = HEADER_BYTES + static_cast<qint64>(chunks);
+    return (end + DATA_ALIGNMENT_bytes - 1) / DATA_ALIGNMENT_bytes * DATA_ALIGNMENT_bytes;
+}
@@ -0,0 +1,186 @@
+#ifndef CHUNKEDGRID_H
+#define CHUNKEDGRID_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "celltype.h"
+
+class QFile;
+class QFileDevice;
+
+// Хранилище клеток блоками CHUNK_SIZE x CHUNK_SIZE. Однородный блок
+// (например, пустое пространство) хранится одним значением, неоднородные
+// держатся в памяти не более residentLimit штук: лишние по LRU выгружаются
+// и подгружаются обратно при обращении.
+//
+// Файл мира: заголовок с отметкой сохранения, каталог блоков (байт на блок - значение однородного
+// блока или DENSE_MARK) и область данных, где у каждого блока фиксированное
+// смещение. Файл мира только читается: сохранение пишет новый файл целиком
+// и подменяет им прежний, измененные блоки до сохранения выгружаются
+// в отдельный временный файл подкачки.
+//
+// Блок в памяти, который уже отдан курсорам, не меняется: запись идет
+// в его копию.
+class ChunkedGrid final {
+
+public:
+    static constexpr int CHUNK_SHIFT = 6;
+    static constexpr int CHUNK_SIZE = 1 << CHUNK_SHIFT;
+    static constexpr int CHUNK_MASK = CHUNK_SIZE - 1;
+    static constexpr int CHUNK_CELLS = CHUNK_SIZE * CHUNK_SIZE;
+
+    static constexpr size_t DEFAULT_RESIDENT_cnt = 4096;
+
+    using ChunkData = std::vector<uint8_t>;
+
+    // Чтение для поиска: блоки закрепляются в курсоре при первом обращении,
+    // дальше чтение идет без блокировок. Запрос держит только блоки
+    // просмотренной им области. После reset/open курсор старой карты
+    // читает одни стены
+    class Cursor final {
+
+    public:
+        explicit Cursor(const ChunkedGrid &grid);
+
+        CellType cell(int x, int y) {
+            if (x < 0 || x >= m_width || y < 0 || y >= m_height)
+                return CellType::Wall;
+
+            int index = (y >> CHUNK_SHIFT) * m_chunksX + (x >> CHUNK_SHIFT);
+            if (index != m_lastIndex)
+                select(index);
+
+            if (!m_data)
+                return static_cast<CellType>(m_value);
+            return static_cast<CellType>(m_data[((y & CHUNK_MASK) << CHUNK_SHIFT) | (x & CHUNK_MASK)]);
+        }
+
+        bool isWalkable(int x, int y) {
+            return cell(x, y) != CellType::Wall;
+        }
+
+        // Размер карты на момент создания курсора
+        int width() const {
+            return m_width;
+        }
+
+        int height() const {
+            return m_height;
+        }
+
+        size_t pinnedChunks() const;
+
+    private:
+        struct Pinned {
+            std::shared_ptr<const ChunkData> data;
+            uint8_t value;
+        };
+
+        const ChunkedGrid *m_grid;
+        quint64 m_layout;
+        int m_width;
+        int m_height;
+        int m_chunksX;
+
+        int m_lastIndex = -1;
+        const uint8_t *m_data = nullptr;
+        uint8_t m_value = 0;
+
+        std::unordered_map<int, Pinned> m_pinned;
+
+        void select(int index);
+    };
+
+    ChunkedGrid();
+    ~ChunkedGrid();
+
+    void reset(int width, int height, CellType fill = CellType::Empty);
+
+    int width() const;
+    int height() const;
+    int chunksX() const;
+    int chunksY() const;
+
+    CellType cell(int x, int y) const;
+    void setCell(int x, int y, CellType type);
+
+    // Запись блока целиком, например при генерации: однородный блок
+    // сохраняется одним значением и не занимает памяти
+    void storeChunk(int chunkX, int chunkY, ChunkData data);
+
+    // Сохранение мира в файл с атомарной подменой; выгруженные блоки дальше
+    // читаются из него
+    bool save(const QString &path);
+    // Подключение мира из файла: блоки читаются по мере обращения.
+    // Мир больше maxWidth x maxHeight не подключается
+    bool open(const QString &path, int maxWidth, int maxHeight);
+    // Случайная отметка, которую save пишет в заголовок: по ней данные,
+    // посчитанные для мира (например, ориентиры), сверяются с файлом.
+    // 0 - мир не связан с файлом
+    quint64 stamp() const;
+
+    void setResidentLimit(size_t chunks);
+    size_t residentChunks() const;
+
+private:
+    static constexpr uint8_t DENSE_MARK = 0xFF;
+
+    struct Slot {
+        std::shared_ptr<ChunkData> data;
+        // Значение однородного блока или DENSE_MARK
+        uint8_t value = 0;
+        // Где лежит актуальная копия блока; нигде - блок изменен в памяти
+        bool inWorld = false;
+        bool inSwap = false;
+    };
+
+    // Меняется при reset/open, курсоры по нему отличают свою карту
+    quint64 m_layout = 0;
+
+    int m_width = 0;
+    int m_height = 0;
+    int m_chunksX = 0;
+    int m_chunksY = 0;
+
+    size_t m_residentLimit = DEFAULT_RESIDENT_cnt;
+
+    // Блоки подгружаются и из константных методов, поэтому состояние mutable
+    mutable QMutex m_mutex;
+    mutable std::vector<Slot> m_slots;
+    mutable std::list<int> m_lru;
+    mutable std::unordered_map<int, std::list<int>::iterator> m_lruPositions;
+    mutable std::unique_ptr<QFile> m_file;
+    // Подкачка: блок index лежит по смещению index * CHUNK_CELLS
+    mutable std::unique_ptr<QFile> m_swap;
+    quint64 m_stamp = 0;
+
+    int chunkIndex(int x, int y) const;
+
+    // Все методы ниже вызываются под m_mutex
+    const std::shared_ptr<ChunkData> &residentChunk(int index) const;
+    void touch(int index) const;
+    void evictExcess() const;
+    void resetStorage();
+
+    bool ensureSwap() const;
+    bool readChunk(QFile &file, qint64 offset, ChunkData &data) const;
+    // Выгруженный блок - из подкачки или из файла мира
+    bool loadChunk(int index, ChunkData &data) const;
+    qint64 worldOffset(int index) const;
+
+    // Запись сохраняемого файла, без блокировки
+    static bool writeHeader(QFileDevice &file, int width, int height, quint64 stamp,
+                            const QByteArray &directory);
+    static bool writeChunk(QFileDevice &file, qint64 offset, const ChunkData &data);
+    static qint64 dataOffset(size_t chunks);
+};
+
+#endif // CHUNKEDGRID_H
@@ -0,0 +1,97 @@
+#include <algorithm>
+
+#include "compactpath.h"
+
+CompactPath::CompactPath(const QPoint &start)
+    : m_start(start), m_end(start) {
+}
+
+CompactPath::CompactPath(const QPoint &start, std::vector<uint32_t> runs)
+    : m_start(start), m_end(start), m_runs(std::move(runs)) {
+
+    int x = start.x();
+    int y = start.y();
+
+    for (uint32_t run : m_runs) {
+        uint8_t dir = run & DIRECTION_MASK;
+        uint32_t length = run >> DIRECTION_BITS;
+        x += Direction::DX[dir] * static_cast<int>(length);
+        y += Direction::DY[dir] * static_cast<int>(length);
+        m_size += length;
+    }
+    m_end = QPoint(x, y);
+}
+
+void CompactPath::appendRun(uint8_t direction, uint32_t length) {
+    m_end = QPoint(m_end.x() + Direction::DX[direction] * static_cast<int>(length),
+                   m_end.y() + Direction::DY[direction] * static_cast<int>(length));
+    m_size += length;
+
+    // Продлеваем последнюю серию, пока хватает разрядов под длину
+    if (!m_runs.empty() && (m_runs.back() & DIRECTION_MASK) == direction) {
+        uint32_t current = m_runs.back() >> DIRECTION_BITS;
+        uint32_t extra = std::min(length, MAX_RUN_LENGTH - current);
+        m_runs.back() = encodeRun(direction, current + extra);
+        length -= extra;
+    }
+
+    while (length > 0) {
+        uint32_t chunk = std::min(length, MAX_RUN_LENGTH);
+        m_runs.push_back(encodeRun(direction, chunk));
+        length -= chunk;
+    }
+}
+
+QPoint CompactPath::start() const {
+    return m_start;
+}
+
+QPoint CompactPath::end() const {
+    return m_end;
+}
+
+size_t CompactPath::size() const {
+    return m_size;
+}
+
+size_t CompactPath::runCount() const {
+    return m_runs.size();
+}
+
+bool CompactPath::isEmpty() const {
+    return m_size <= 1;
+}
+
+bool CompactPath::contains(const QPoint &point) const {
+    if (point == m_start)
+        return true;
+
+    int x = m_start.x();
+    int y = m_start.y();
+
+    // Проверяем попадание в отрезок серии целиком, не перебирая клетки
+    for (uint32_t run : m_runs) {
+        uint8_t dir = run & DIRECTION_MASK;
+        int length = static_cast<int>(run >> DIRECTION_BITS);
+        int dx = Direction::DX[dir];
+        int dy = Direction::DY[dir];
+
+        // Номер шага серии, на котором могла бы лежать точка; для диагонали
+        // он должен совпасть по обеим осям
+        int offset = dx != 0 ? (point.x() - x) * dx : (point.y() - y) * dy;
+        bool onLine = point.x() == x + dx * offset && point.y() == y + dy * offset;
+        if (onLine && offset >= 1 && offset <= length)
+            return true;
+
+        x += dx * length;
+        y += dy * length;
+    }
+    return false;
+}
+
+std::vector<QPoint> CompactPath::toPoints() const {
+    std::vector<QPoint> points;
+    points.reserve(m_size);
+    forEach([&points](const QPoint &point) { points.push_back(point); });
+    return points;
+}
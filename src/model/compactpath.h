@@ -0,0 +1,92 @@
+#ifndef COMPACTPATH_H
+#define COMPACTPATH_H
+
+#include <QMetaType>
+#include <QPoint>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "direction.h"
+
+// Путь в виде стартовой клетки и цепочки направлений, сжатой по сериям:
+// каждая серия - одно 32-битное слово (направление + длина). Прямой коридор
+// любой длины занимает одно слово, поэтому память зависит от числа поворотов,
+// а не от длины пути.
+//
+// После построения путь неизменяем и передается через PathPtr, так что
+// пересылка между потоками и хранение в сцене не копируют точки.
+class CompactPath final {
+
+    static constexpr int DIRECTION_BITS = 3;
+    static constexpr uint32_t DIRECTION_MASK = (1u << DIRECTION_BITS) - 1;
+
+public:
+    static constexpr uint32_t MAX_RUN_LENGTH = UINT32_MAX >> DIRECTION_BITS;
+
+    explicit CompactPath(const QPoint &start);
+
+    // Серии в порядке от старта; длинные серии должны быть уже разбиты
+    // по MAX_RUN_LENGTH (см. appendRun)
+    CompactPath(const QPoint &start, std::vector<uint32_t> runs);
+
+    static uint32_t encodeRun(uint8_t direction, uint32_t length) {
+        return (length << DIRECTION_BITS) | direction;
+    }
+
+    static uint8_t runDirection(uint32_t run) {
+        return run & DIRECTION_MASK;
+    }
+
+    static uint32_t runLength(uint32_t run) {
+        return run >> DIRECTION_BITS;
+    }
+
+    void appendRun(uint8_t direction, uint32_t length);
+
+    QPoint start() const;
+    QPoint end() const;
+
+    // Количество клеток пути, включая стартовую
+    size_t size() const;
+    size_t runCount() const;
+    // Серии как есть, в формате encodeRun - для передачи без распаковки
+    const std::vector<uint32_t> &runs() const { return m_runs; }
+    // Ни одного шага: путь из одной стартовой клетки
+    bool isEmpty() const;
+
+    bool contains(const QPoint &point) const;
+    std::vector<QPoint> toPoints() const;
+
+    // Обход клеток пути по порядку без распаковки в вектор
+    template <typename Visitor>
+    void forEach(Visitor &&visitor) const {
+        int x = m_start.x();
+        int y = m_start.y();
+        visitor(QPoint(x, y));
+
+        for (uint32_t run : m_runs) {
+            uint8_t dir = run & DIRECTION_MASK;
+            uint32_t length = run >> DIRECTION_BITS;
+            for (uint32_t i = 0; i < length; ++i) {
+                x += Direction::DX[dir];
+                y += Direction::DY[dir];
+                visitor(QPoint(x, y));
+            }
+        }
+    }
+
+private:
+    QPoint m_start;
+    QPoint m_end;
+    size_t m_size = 1;
+
+    std::vector<uint32_t> m_runs;
+};
+
+using PathPtr = std::shared_ptr<const CompactPath>;
+
+Q_DECLARE_METATYPE(PathPtr)
+
+#endif // COMPACTPATH_H
@@ -0,0 +1,414 @@
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <random>
+#include <unordered_set>
+
+#include "cooperativeplanner.h"
+#include "direction.h"
+#include "searchkernel.h"
+#include "searchworkspace.h"
+#include "tracing.h"
+
+namespace {
+
+constexpr uint16_t UNREACHABLE = 0xFFFF;
+constexpr uint16_t MAX_DISTANCE = 0xFFFE;
+
+// Код хода "остаться на месте", следует за кодами направлений
+constexpr uint8_t WAIT = Direction::EXTENDED_COUNT;
+
+// Агенты ходят только по прямой или стоят на месте
+constexpr uint8_t MOVES[] = { Direction::DOWN, Direction::RIGHT, Direction::UP,
+                              Direction::LEFT, WAIT };
+
+} // namespace
+
+CooperativePlanner::CooperativePlanner(GridModel *model, QObject *parent)
+    : QObject(parent), m_model(model) {
+
+    connect(m_model, &GridModel::layoutChanged, this, &CooperativePlanner::clear);
+    connect(m_model, &GridModel::cellsChanged, this,
+            &CooperativePlanner::onCellsChanged);
+}
+
+void CooperativePlanner::setWindow(int steps) {
+    m_window = std::max(1, steps);
+}
+
+void CooperativePlanner::setTimeBudget(int budget_ms) {
+    m_budget_ms = std::max(0, budget_ms);
+}
+
+bool CooperativePlanner::isSupported() const {
+    return static_cast<size_t>(m_model->width()) * m_model->height() <= MAX_CELLS_cnt;
+}
+
+bool CooperativePlanner::addAgent(const QPoint &position, const QPoint &goal) {
+    if (!isSupported() || !m_model->isWalkable(position.x(), position.y()) ||
+        !m_model->isWalkable(goal.x(), goal.y()))
+        return false;
+
+    for (const auto &agent : m_agents) {
+        if (agent.position == position)
+            return false;
+    }
+
+    m_agents.push_back({ position, goal, {} });
+    return true;
+}
+
+int CooperativePlanner::spawnRandomAgents(int count) {
+    int width = m_model->width();
+    int height = m_model->height();
+    if (width <= 0 || height <= 0 || !isSupported())
+        return 0;
+
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<int> randomX(0, width - 1);
+    std::uniform_int_distribution<int> randomY(0, height - 1);
+
+    auto randomCell = [&]() {
+        return QPoint(randomX(gen), randomY(gen));
+    };
+
+    // Случайные клетки, а не перемешанный список всех проходимых: на большой
+    // карте список не помещается в память. Число попыток ограничено -
+    // карта может быть почти целиком занята стенами
+    int added = 0;
+    for (int attempt = 0; added < count && attempt < count * SPAWN_ATTEMPTS_cnt; ++attempt) {
+        if (addAgent(randomCell(), randomCell()))
+            ++added;
+    }
+
+    emit agentsChanged();
+    return added;
+}
+
+void CooperativePlanner::clear() {
+    m_agents.clear();
+    clearDistanceFields();
+    m_nextAgent = 0;
+
+    emit agentsChanged();
+}
+
+const std::vector<CooperativePlanner::Agent> &CooperativePlanner::agents() const {
+    return m_agents;
+}
+
+void CooperativePlanner::tick() {
+    if (m_agents.empty())
+        return;
+
+    TRACE_SPAN("planner", "tick");
+
+    int cells = m_model->width() * m_model->height();
+    if (m_reservations.cells() != cells || m_reservations.window() != m_window)
+        m_reservations.reset(cells, m_window);
+    else
+        m_reservations.clear();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Агенты с действующим планом резервируют первыми, остальные
+    // планируются в обход них по очереди, начиная с m_nextAgent
+    std::vector<bool> replan(m_agents.size());
+    for (size_t i = 0; i < m_agents.size(); ++i) {
+        replan[i] = needsReplan(m_agents[i]);
+        if (!replan[i])
+            reserveAgent(m_agents[i]);
+    }
+
+    size_t firstSkipped = m_agents.size();
+    for (size_t k = 0; k < m_agents.size(); ++k) {
+        size_t i = (m_nextAgent + k) % m_agents.size();
+        if (!replan[i])
+            continue;
+
+        PlanResult result = timer.elapsed() < m_budget_ms ? planAgent(m_agents[i], timer)
+                                                          : PlanResult::Deferred;
+        if (result == PlanResult::Deferred && firstSkipped == m_agents.size())
+            firstSkipped = i;
+
+        reserveAgent(m_agents[i]);
+    }
+
+    // Не успевшие в бюджет начнут следующий такт; иначе сдвигаем очередь,
+    // чтобы приоритет не закреплялся за одними и теми же агентами
+    if (firstSkipped != m_agents.size())
+        m_nextAgent = firstSkipped;
+    else
+        m_nextAgent = (m_nextAgent + 1) % m_agents.size();
+
+    moveAgents();
+
+    emit agentsChanged();
+}
+
+bool CooperativePlanner::needsReplan(const Agent &agent) const {
+    if (agent.plan.empty())
+        return agent.position != agent.goal;
+    return agent.plan.back() != agent.goal &&
+           static_cast<int>(agent.plan.size()) < m_window / 2;
+}
+
+CooperativePlanner::PlanResult CooperativePlanner::planAgent(Agent &agent,
+                                                             const QElapsedTimer &timer) {
+    const int width = m_model->width();
+    const size_t cells = static_cast<size_t>(width) * m_model->height();
+
+    const DistanceField *field = distanceField(agent.goal, timer);
+    if (!field)
+        return PlanResult::Deferred;
+    const std::vector<uint16_t> &distances = field->distances;
+
+    const uint32_t startCell = agent.position.y() * width + agent.position.x();
+    const uint32_t goalCell = agent.goal.y() * width + agent.goal.x();
+    if (distances[startCell] == UNREACHABLE) {
+        agent.plan.clear();
+        return PlanResult::NoPath;
+    }
+
+    // Состояние - пара (клетка, момент), ключ time * cells + cell.
+    // Стоимость состояния равна моменту, поэтому первое попадание в него
+    // уже оптимально и повторно его не открываем. Поиск не уходит от старта
+    // дальше окна, поэтому состояния - в хэш-таблице, а не в массиве
+    // на все клетки карты и моменты
+    m_states.clear();
+    m_heap.clear();
+
+    ChunkedGrid::Cursor grid = m_model->cursor();
+
+    using HeapEntry = SearchWorkspace::HeapEntry;
+    auto later = [](const HeapEntry &a, const HeapEntry &b) {
+        return a.estimate > b.estimate || (a.estimate == b.estimate && a.cost < b.cost);
+    };
+
+    m_states.emplace(startCell, Direction::NONE);
+    m_heap.push_back({ distances[startCell], 0, startCell });
+
+    bool found = false;
+    size_t finalState = 0;
+
+    for (size_t popped = 0; !m_heap.empty(); ++popped) {
+        // Старый план агента остается в силе
+        if (popped % SearchKernel::STOP_CHECK_INTERVAL_cnt == 0 && timer.elapsed() >= m_budget_ms)
+            return PlanResult::Deferred;
+
+        std::pop_heap(m_heap.begin(), m_heap.end(), later);
+        HeapEntry entry = m_heap.back();
+        m_heap.pop_back();
+
+        const int time = entry.cost;
+        const int cell = entry.index;
+
+        // Окно исчерпано или цель достигнута: дальше агент пойдет
+        // по следующему плану
+        if (entry.index == goalCell || time == m_window) {
+            finalState = time * cells + cell;
+            found = true;
+            break;
+        }
+
+        int cx = cell % width;
+        int cy = cell / width;
+
+        for (uint8_t move : MOVES) {
+            int nx = cx;
+            int ny = cy;
+            if (move != WAIT) {
+                nx += Direction::DX[move];
+                ny += Direction::DY[move];
+                if (!grid.isWalkable(nx, ny))
+                    continue;
+            }
+
+            int next = ny * width + nx;
+            if (distances[next] == UNREACHABLE || m_reservations.isReserved(next, time + 1))
+                continue;
+
+            // Встречный обмен клетками: резерв ничей, поэтому проверка с запасом
+            if (move != WAIT && m_reservations.isReserved(next, time) &&
+                m_reservations.isReserved(cell, time + 1))
+                continue;
+
+            size_t nextState = (time + 1) * cells + next;
+            if (!m_states.emplace(nextState, move).second)
+                continue;
+
+            m_heap.push_back({ static_cast<uint32_t>(time + 1 + distances[next]),
+                               static_cast<uint32_t>(time + 1),
+                               static_cast<uint32_t>(next) });
+            std::push_heap(m_heap.begin(), m_heap.end(), later);
+        }
+    }
+
+    agent.plan.clear();
+    if (!found)
+        return PlanResult::NoPath;
+
+    for (size_t state = finalState;;) {
+        uint8_t move = m_states.at(state);
+        if (move == Direction::NONE)
+            break;
+
+        size_t time = state / cells;
+        size_t cell = state % cells;
+        agent.plan.push_back(QPoint(static_cast<int>(cell % width), static_cast<int>(cell / width)));
+
+        if (move != WAIT)
+            cell -= Direction::DY[move] * width + Direction::DX[move];
+        state = (time - 1) * cells + cell;
+    }
+
+    std::reverse(agent.plan.begin(), agent.plan.end());
+    return PlanResult::Planned;
+}
+
+void CooperativePlanner::reserveAgent(const Agent &agent) {
+    int width = m_model->width();
+    auto index = [width](const QPoint &point) {
+        return point.y() * width + point.x();
+    };
+
+    m_reservations.reserve(index(agent.position), 0);
+
+    int time = 1;
+    for (const auto &point : agent.plan)
+        m_reservations.reserve(index(point), time++);
+
+    // После конца плана агент стоит на месте до конца окна
+    QPoint last = agent.plan.empty() ? agent.position : agent.plan.back();
+    for (; time <= m_window; ++time)
+        m_reservations.reserve(index(last), time);
+}
+
+void CooperativePlanner::moveAgents() {
+    int width = m_model->width();
+    // Занятых клеток столько же, сколько агентов, - не массив на всю карту
+    std::unordered_set<int> occupied;
+    for (const auto &agent : m_agents)
+        occupied.insert(agent.position.y() * width + agent.position.x());
+
+    // Планы согласованы через резерв, но план, не обновленный из-за
+    // бюджета, мог устареть. Двигаем проходами: агент, упершийся в
+    // уходящего соседа, пройдет на следующем проходе
+    std::vector<size_t> pending;
+    for (size_t i = 0; i < m_agents.size(); ++i) {
+        if (!m_agents[i].plan.empty())
+            pending.push_back(i);
+    }
+
+    bool moved = true;
+    while (moved && !pending.empty()) {
+        moved = false;
+
+        std::vector<size_t> blocked;
+        for (size_t i : pending) {
+            Agent &agent = m_agents[i];
+            QPoint next = agent.plan.front();
+            int nextIndex = next.y() * width + next.x();
+
+            if (next != agent.position &&
+                (occupied.count(nextIndex) || !m_model->isWalkable(next.x(), next.y()))) {
+                blocked.push_back(i);
+                continue;
+            }
+
+            occupied.erase(agent.position.y() * width + agent.position.x());
+            occupied.insert(nextIndex);
+            agent.position = next;
+            agent.plan.erase(agent.plan.begin());
+            moved = true;
+        }
+        pending.swap(blocked);
+    }
+
+    // Застрявшие ждут на месте и перепланируются в следующем такте
+    for (size_t i : pending)
+        m_agents[i].plan.clear();
+}
+
+const CooperativePlanner::DistanceField *CooperativePlanner::distanceField(
+                                    const QPoint &goal, const QElapsedTimer &timer) {
+    int width = m_model->width();
+    size_t cells = static_cast<size_t>(width) * m_model->height();
+    int goalIndex = goal.y() * width + goal.x();
+
+    auto it = m_distanceFieldIndex.find(goalIndex);
+    if (it != m_distanceFieldIndex.end()) {
+        m_distanceFields.splice(m_distanceFields.begin(), m_distanceFields, it->second);
+    } else {
+        DistanceField field;
+        field.goal = goalIndex;
+        field.distances.assign(cells, UNREACHABLE);
+        field.distances[goalIndex] = 0;
+        field.queue.push_back(goalIndex);
+
+        m_distanceFields.push_front(std::move(field));
+        m_distanceFieldIndex[goalIndex] = m_distanceFields.begin();
+
+        // Число полей ограничено памятью: на большой карте кэш держит одно
+        size_t capacity = std::max<size_t>(1, DISTANCE_CACHE_bytes / (cells * sizeof(uint16_t)));
+        while (m_distanceFields.size() > capacity) {
+            m_distanceFieldIndex.erase(m_distanceFields.back().goal);
+            m_distanceFields.pop_back();
+        }
+    }
+
+    DistanceField &field = m_distanceFields.front();
+    if (!field.complete && !extendField(field, timer))
+        return nullptr;
+    return &field;
+}
+
+bool CooperativePlanner::extendField(DistanceField &field, const QElapsedTimer &timer) {
+    TRACE_SPAN("planner", "distanceField");
+
+    // Обратный BFS от цели: точная эвристика для всех агентов с этой целью.
+    // Прерывается по бюджету такта и продолжается с того же места
+    int width = m_model->width();
+    ChunkedGrid::Cursor grid = m_model->cursor();
+    std::vector<uint16_t> &distances = field.distances;
+
+    for (size_t popped = 0; !field.queue.empty(); ++popped) {
+        if (popped % SearchKernel::STOP_CHECK_INTERVAL_cnt == 0 && timer.elapsed() >= m_budget_ms)
+            return false;
+
+        int current = field.queue.front();
+        field.queue.pop_front();
+        int cx = current % width;
+        int cy = current / width;
+        uint16_t next = std::min<int>(distances[current] + 1, MAX_DISTANCE);
+
+        for (uint8_t dir = 0; dir < Direction::COUNT; ++dir) {
+            int nx = cx + Direction::DX[dir];
+            int ny = cy + Direction::DY[dir];
+            if (!grid.isWalkable(nx, ny))
+                continue;
+
+            int neighbor = ny * width + nx;
+            if (distances[neighbor] == UNREACHABLE) {
+                distances[neighbor] = next;
+                field.queue.push_back(neighbor);
+            }
+        }
+    }
+
+    field.complete = true;
+    return true;
+}
+
+void CooperativePlanner::clearDistanceFields() {
+    m_distanceFields.clear();
+    m_distanceFieldIndex.clear();
+}
+
+void CooperativePlanner::onCellsChanged(const GridDelta &delta) {
+    // Поля расстояний зависят только от проходимости
+    if (!delta.opened.empty() || !delta.closed.empty())
+        clearDistanceFields();
+}
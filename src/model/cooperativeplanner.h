@@ -0,0 +1,119 @@
+#ifndef COOPERATIVEPLANNER_H
+#define COOPERATIVEPLANNER_H
+
+#include <QObject>
+#include <QPoint>
+
+#include <deque>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "gridmodel.h"
+#include "reservationtable.h"
+#include "searchworkspace.h"
+
+class QElapsedTimer;
+
+// Кооперативный поиск путей для множества агентов (windowed HCA*).
+// Каждый агент планирует на окно из window шагов в пространстве-времени,
+// обходя клетки, зарезервированные агентами, спланированными раньше.
+// Эвристика - точное расстояние до цели (обратный BFS от цели, кэшируется
+// по цели). Все агенты сдвигаются на шаг за такт, перепланирование
+// ограничено бюджетом времени: не успевшие агенты идут по старому плану.
+// В бюджет входит и построение полей расстояний - на большой карте поле
+// достраивается за несколько тактов.
+class CooperativePlanner final : public QObject {
+    Q_OBJECT
+
+    static constexpr int DEFAULT_WINDOW_cnt = 16;
+    static constexpr int DEFAULT_BUDGET_ms = 8;
+    // Память под кэш полей расстояний, по два байта на клетку поля
+    static constexpr size_t DISTANCE_CACHE_bytes = size_t(64) << 20;
+    // Поле расстояний покрывает всю карту и выделяется в потоке GUI -
+    // на картах больше этого агенты не добавляются
+    static constexpr size_t MAX_CELLS_cnt = size_t(1) << 22;
+    // Попыток на агента при случайной расстановке
+    static constexpr int SPAWN_ATTEMPTS_cnt = 64;
+
+public:
+    struct Agent {
+        QPoint position;
+        QPoint goal;
+        // Следующие позиции по тактам, plan[0] - позиция после ближайшего шага
+        std::vector<QPoint> plan;
+    };
+
+    explicit CooperativePlanner(GridModel *model, QObject *parent = nullptr);
+
+    void setWindow(int steps);
+    void setTimeBudget(int budget_ms);
+
+    // Карта не больше MAX_CELLS_cnt клеток
+    bool isSupported() const;
+
+    // Возвращает false, если карта не поддерживается, старт или цель
+    // непроходимы или старт занят
+    bool addAgent(const QPoint &position, const QPoint &goal);
+    // Агенты на случайных различных стартах со случайными целями
+    int spawnRandomAgents(int count);
+    void clear();
+
+    const std::vector<Agent> &agents() const;
+
+public slots:
+    void tick();
+
+signals:
+    void agentsChanged();
+
+private:
+    enum class PlanResult {
+        Planned,
+        NoPath,
+        // Бюджет такта исчерпан, агент остается со старым планом
+        Deferred
+    };
+
+    struct DistanceField {
+        int goal;
+        std::vector<uint16_t> distances;
+        // Очередь обратного BFS, пока поле не достроено. deque растет
+        // без копирования всей очереди - такт не тратит бюджет на перенос
+        std::deque<uint32_t> queue;
+        bool complete = false;
+    };
+
+    GridModel *m_model;
+
+    int m_window = DEFAULT_WINDOW_cnt;
+    int m_budget_ms = DEFAULT_BUDGET_ms;
+
+    std::vector<Agent> m_agents;
+    // С кого начинать перепланирование в следующем такте
+    size_t m_nextAgent = 0;
+
+    ReservationTable m_reservations;
+
+    // Поля по целям, недавно использованные - в начале списка
+    std::list<DistanceField> m_distanceFields;
+    std::unordered_map<int, std::list<DistanceField>::iterator> m_distanceFieldIndex;
+
+    // Просмотренные состояния (клетка, момент) окна и ход, которым в них
+    // пришли; открытый список - по клеткам, момент хранится в cost
+    std::unordered_map<size_t, uint8_t> m_states;
+    std::vector<SearchWorkspace::HeapEntry> m_heap;
+
+    bool needsReplan(const Agent &agent) const;
+    PlanResult planAgent(Agent &agent, const QElapsedTimer &timer);
+    void reserveAgent(const Agent &agent);
+    void moveAgents();
+
+    // nullptr - поле еще не достроено за отведенное время
+    const DistanceField *distanceField(const QPoint &goal, const QElapsedTimer &timer);
+    bool extendField(DistanceField &field, const QElapsedTimer &timer);
+    void clearDistanceFields();
+    void onCellsChanged(const GridDelta &delta);
+};
+
+#endif // COOPERATIVEPLANNER_H
@@ -0,0 +1,39 @@
+#ifndef DIRECTION_H
+#define DIRECTION_H
+
+#include <cstdint>
+
+// Коды направлений шага по сетке. Порядок совпадает с порядком обхода соседей
+// в поиске, код хранится в рабочей области как "откуда пришли" в клетку.
+// Первые COUNT кодов - прямые шаги, за ними диагонали для 8-связной сетки.
+namespace Direction {
+
+constexpr uint8_t DOWN = 0;
+constexpr uint8_t RIGHT = 1;
+constexpr uint8_t UP = 2;
+constexpr uint8_t LEFT = 3;
+
+constexpr uint8_t DOWN_RIGHT = 4;
+constexpr uint8_t UP_RIGHT = 5;
+constexpr uint8_t UP_LEFT = 6;
+constexpr uint8_t DOWN_LEFT = 7;
+
+constexpr uint8_t COUNT = 4;
+constexpr uint8_t EXTENDED_COUNT = 8;
+constexpr uint8_t NONE = 0xFF;
+
+constexpr int DX[EXTENDED_COUNT] = { 0, 1,  0, -1, 1,  1, -1, -1 };
+constexpr int DY[EXTENDED_COUNT] = { 1, 0, -1,  0, 1, -1, -1,  1 };
+
+constexpr bool isDiagonal(uint8_t dir) {
+    return dir >= COUNT && dir < EXTENDED_COUNT;
+}
+
+// Противоположный шаг: в каждой четверке кодов он через одну позицию
+constexpr uint8_t opposite(uint8_t dir) {
+    return dir ^ 2;
+}
+
+} // namespace Direction
+
+#endif // DIRECTION_H
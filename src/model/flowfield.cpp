@@ -0,0 +1,111 @@
+#include <algorithm>
+
+#include "flowfield.h"
+
+FlowField::FlowField(const QPoint &goal, int width, int height, int directionCount)
+    : m_goal(goal), m_width(width), m_height(height),
+      m_bits(directionCount > Direction::COUNT ? 4 : 3),
+      m_cellsPerWord(64 / m_bits),
+      m_none(static_cast<uint8_t>((1u << m_bits) - 1)) {
+
+    size_t cells = static_cast<size_t>(width) * height;
+    // Все биты - единицы: каждая клетка сразу NONE
+    m_words.assign((cells + m_cellsPerWord - 1) / m_cellsPerWord, ~uint64_t(0));
+}
+
+QPoint FlowField::nextStep(const QPoint &cell) const {
+    uint8_t dir = direction(cell.x(), cell.y());
+    if (dir == Direction::NONE)
+        return cell;
+    return QPoint(cell.x() + Direction::DX[dir], cell.y() + Direction::DY[dir]);
+}
+
+bool FlowField::isReachable(const QPoint &cell) const {
+    return cell == m_goal || direction(cell.x(), cell.y()) != Direction::NONE;
+}
+
+void FlowField::setDirection(int x, int y, uint8_t dir) {
+    size_t cell = static_cast<size_t>(y) * m_width + x;
+    int shift = static_cast<int>(cell % m_cellsPerWord) * m_bits;
+
+    uint64_t &word = m_words[cell / m_cellsPerWord];
+    word &= ~(uint64_t(m_none) << shift);
+    word |= uint64_t(dir == Direction::NONE ? m_none : dir) << shift;
+}
+
+bool FlowField::touches(const QRect &region) const {
+    QRect area = region.adjusted(-1, -1, 1, 1).intersected(QRect(0, 0, m_width, m_height));
+    if (area.isEmpty())
+        return false;
+
+    for (int y = area.top(); y <= area.bottom(); ++y) {
+        for (int x = area.left(); x <= area.right(); ++x) {
+            if (isReachable(QPoint(x, y)))
+                return true;
+        }
+    }
+    return false;
+}
+
+size_t FlowField::memoryBytes() const {
+    return m_words.size() * sizeof(uint64_t);
+}
+
+FlowFieldPtr FlowFieldCache::find(const QPoint &goal, int variant) {
+    QMutexLocker locker(&m_mutex);
+
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (it->variant == variant && it->field->goal() == goal) {
+            m_entries.splice(m_entries.begin(), m_entries, it);
+            return m_entries.front().field;
+        }
+    }
+    return nullptr;
+}
+
+void FlowFieldCache::insert(FlowFieldPtr field, int variant, quint64 generation) {
+    if (!field)
+        return;
+
+    QMutexLocker locker(&m_mutex);
+    if (generation != m_generation)
+        return;
+
+    // То же поле могли построить параллельно - остается одно
+    m_entries.remove_if([&](const Entry &entry) {
+        return entry.variant == variant && entry.field->goal() == field->goal();
+    });
+
+    m_entries.push_front({ variant, std::move(field) });
+    while (static_cast<int>(m_entries.size()) > m_capacity)
+        m_entries.pop_back();
+}
+
+quint64 FlowFieldCache::generation() const {
+    QMutexLocker locker(&m_mutex);
+    return m_generation;
+}
+
+void FlowFieldCache::invalidate(const QRect &region) {
+    QMutexLocker locker(&m_mutex);
+
+    ++m_generation;
+    m_entries.remove_if([&region](const Entry &entry) {
+        return entry.field->touches(region);
+    });
+}
+
+void FlowFieldCache::clear() {
+    QMutexLocker locker(&m_mutex);
+
+    ++m_generation;
+    m_entries.clear();
+}
+
+void FlowFieldCache::setCapacity(int count) {
+    QMutexLocker locker(&m_mutex);
+
+    m_capacity = std::max(1, count);
+    while (static_cast<int>(m_entries.size()) > m_capacity)
+        m_entries.pop_back();
+}
@@ -0,0 +1,113 @@
+#ifndef FLOWFIELD_H
+#define FLOWFIELD_H
+
+#include <QMetaType>
+#include <QMutex>
+#include <QPoint>
+#include <QRect>
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <vector>
+
+#include "direction.h"
+
+// Поле направлений к одной цели: для каждой клетки - код следующего шага
+// по кратчайшему пути (Direction), получается одним обратным поиском от цели.
+// Следующий шаг любого агента - чтение нескольких бит, без поиска.
+//
+// Коды упакованы в 64-битные слова без переходов через границу слова:
+// 3 бита на клетку для 4-связной сетки (4 направления + NONE), 4 бита -
+// для 8-связной (8 направлений + NONE). NONE - цель или недостижимая клетка.
+class FlowField final {
+
+public:
+    FlowField(const QPoint &goal, int width, int height, int directionCount);
+
+    QPoint goal() const {
+        return m_goal;
+    }
+
+    int width() const {
+        return m_width;
+    }
+
+    int height() const {
+        return m_height;
+    }
+
+    uint8_t direction(int x, int y) const {
+        size_t cell = static_cast<size_t>(y) * m_width + x;
+        uint64_t word = m_words[cell / m_cellsPerWord];
+        uint8_t code = (word >> ((cell % m_cellsPerWord) * m_bits)) & m_none;
+        return code == m_none ? Direction::NONE : code;
+    }
+
+    // Клетка после шага; для цели и недостижимых - она же
+    QPoint nextStep(const QPoint &cell) const;
+    bool isReachable(const QPoint &cell) const;
+
+    // Задается при построении, до публикации поля
+    void setDirection(int x, int y, uint8_t dir);
+
+    // Может ли правка клеток region изменить поле: рядом с ней есть
+    // достижимые клетки (закрытая клетка рвет пути, открытая дает новые)
+    bool touches(const QRect &region) const;
+
+    size_t memoryBytes() const;
+
+private:
+    QPoint m_goal;
+    int m_width;
+    int m_height;
+
+    int m_bits;
+    int m_cellsPerWord;
+    // Все единицы кода - NONE
+    uint8_t m_none;
+
+    std::vector<uint64_t> m_words;
+};
+
+using FlowFieldPtr = std::shared_ptr<const FlowField>;
+
+Q_DECLARE_METATYPE(FlowFieldPtr)
+
+// Кэш полей по целям с вытеснением давно не использованных (LRU).
+// variant различает режимы поиска для одной цели, его задает вызывающий.
+// Потокобезопасен.
+//
+// Поле, построенное по карте до правки, не должно попасть в кэш после нее:
+// построение запоминает generation() до снимка карты, insert() с устаревшим
+// поколением ничего не делает.
+class FlowFieldCache final {
+
+    static constexpr int DEFAULT_CAPACITY_cnt = 16;
+
+public:
+    FlowFieldPtr find(const QPoint &goal, int variant);
+    void insert(FlowFieldPtr field, int variant, quint64 generation);
+
+    quint64 generation() const;
+
+    // Сбрасывает поля, которые затрагивает правка клеток region
+    void invalidate(const QRect &region);
+    void clear();
+
+    void setCapacity(int count);
+
+private:
+    struct Entry {
+        int variant;
+        FlowFieldPtr field;
+    };
+
+    mutable QMutex m_mutex;
+    // Недавно использованные - в начале; полей немного, поиск линейный
+    std::list<Entry> m_entries;
+    int m_capacity = DEFAULT_CAPACITY_cnt;
+    quint64 m_generation = 0;
+};
+
+#endif // FLOWFIELD_H
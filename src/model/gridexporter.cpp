@@ -0,0 +1,249 @@
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <numeric>
+
+#include "gridexporter.h"
+#include "tracing.h"
+
+namespace {
+
+constexpr int INDEX_VERSION = 1;
+
+// Палитра по значениям CellType, цвета как в GridScene
+QList<QRgb> cellPalette() {
+    return {
+        qRgb(255, 255, 255), // Empty
+        qRgb(128, 128, 128), // Wall
+        qRgb(0, 255, 0),     // Start
+        qRgb(255, 0, 0),     // End
+        qRgb(0, 0, 255),     // Path
+        qRgb(255, 255, 200), // Visited - область setReachable
+    };
+}
+
+// Шаги серии 1..length, на которых координата position + step * delta
+// остается в [low, high], сужают [first, last]
+void clipSteps(int position, int delta, int low, int high, int &first, int &last) {
+    if (delta == 0) {
+        if (position < low || position > high)
+            last = first - 1;
+        return;
+    }
+    if (delta > 0) {
+        first = std::max(first, low - position);
+        last = std::min(last, high - position);
+    } else {
+        first = std::max(first, position - high);
+        last = std::min(last, position - low);
+    }
+}
+
+// Клетки пути внутри region: у каждой серии обходится только ее отрезок
+// в области, серии вне области пропускаются целиком
+template <typename Visitor>
+void forEachInRegion(const CompactPath &path, const QRect &region, Visitor &&visitor) {
+    QPoint position = path.start();
+    if (region.contains(position))
+        visitor(position);
+
+    for (uint32_t run : path.runs()) {
+        const uint8_t dir = CompactPath::runDirection(run);
+        const int length = static_cast<int>(CompactPath::runLength(run));
+        const QPoint step(Direction::DX[dir], Direction::DY[dir]);
+
+        int first = 1;
+        int last = length;
+        clipSteps(position.x(), step.x(), region.left(), region.right(), first, last);
+        clipSteps(position.y(), step.y(), region.top(), region.bottom(), first, last);
+
+        for (int i = first; i <= last; ++i)
+            visitor(position + step * i);
+
+        position += step * length;
+    }
+}
+
+} // namespace
+
+GridExporter::GridExporter(const GridModel *model)
+    : m_model(model) {
+}
+
+void GridExporter::setCellSize(int pixels) {
+    m_cellSize = std::max(1, pixels);
+}
+
+void GridExporter::setTileSize(int pixels) {
+    m_tileSize = std::max(1, pixels);
+}
+
+void GridExporter::addPath(PathPtr path) {
+    if (!path)
+        return;
+
+    QRect bounds(path->start().x(), path->start().y(), 1, 1);
+    QPoint position = path->start();
+    for (uint32_t run : path->runs()) {
+        const uint8_t dir = CompactPath::runDirection(run);
+        position += QPoint(Direction::DX[dir], Direction::DY[dir]) *
+                    static_cast<int>(CompactPath::runLength(run));
+        bounds = bounds.united(QRect(position.x(), position.y(), 1, 1));
+    }
+
+    m_paths.push_back({ std::move(path), bounds });
+}
+
+void GridExporter::setReachable(FlowFieldPtr field) {
+    m_reachable = std::move(field);
+}
+
+int GridExporter::tileCells() const {
+    return std::max(1, m_tileSize / m_cellSize);
+}
+
+QImage GridExporter::render(const QRect &cells) const {
+    QRect region = cells.intersected(QRect(0, 0, m_model->width(), m_model->height()));
+    if (region.isEmpty())
+        return QImage();
+
+    QImage image(region.width() * m_cellSize, region.height() * m_cellSize,
+                 QImage::Format_Indexed8);
+    if (image.isNull())
+        return image;
+    image.setColorTable(cellPalette());
+
+    // У каждой плитки свой курсор: закреплены только блоки ее области
+    ChunkedGrid::Cursor grid = m_model->cursor();
+
+    const FlowField *reachable = m_reachable && m_reachable->width() == m_model->width() &&
+                                         m_reachable->height() == m_model->height()
+                                     ? m_reachable.get()
+                                     : nullptr;
+    const auto emptyValue = static_cast<uchar>(CellType::Empty);
+    const auto reachableValue = static_cast<uchar>(CellType::Visited);
+
+    for (int y = 0; y < region.height(); ++y) {
+        uchar *line = image.scanLine(y * m_cellSize);
+        const int cy = region.top() + y;
+
+        for (int x = 0; x < region.width(); ++x) {
+            const int cx = region.left() + x;
+            auto value = static_cast<uchar>(grid.cell(cx, cy));
+            if (value == emptyValue && reachable && reachable->isReachable(QPoint(cx, cy)))
+                value = reachableValue;
+            std::memset(line + x * m_cellSize, value, m_cellSize);
+        }
+        // Клетка крупнее пикселя - строка повторяется
+        for (int repeat = 1; repeat < m_cellSize; ++repeat)
+            std::memcpy(image.scanLine(y * m_cellSize + repeat), line, image.bytesPerLine());
+    }
+
+    const auto pathValue = static_cast<uchar>(CellType::Path);
+    for (const auto &entry : m_paths) {
+        if (!entry.bounds.intersects(region))
+            continue;
+
+        forEachInRegion(*entry.path, region, [&](const QPoint &point) {
+            int px = (point.x() - region.left()) * m_cellSize;
+            int py = (point.y() - region.top()) * m_cellSize;
+
+            // Точки А и Б остаются своим цветом
+            uchar current = image.scanLine(py)[px];
+            if (current == static_cast<uchar>(CellType::Start) ||
+                current == static_cast<uchar>(CellType::End))
+                return;
+
+            for (int dy = 0; dy < m_cellSize; ++dy)
+                std::memset(image.scanLine(py + dy) + px, pathValue, m_cellSize);
+        });
+    }
+
+    return image;
+}
+
+bool GridExporter::exportTiles(const QString &directory, const CancellationToken &token) const {
+    TRACE_SPAN("export", "exportTiles");
+
+    const int width = m_model->width();
+    const int height = m_model->height();
+    if (width <= 0 || height <= 0)
+        return false;
+
+    QDir dir(directory);
+    if (!dir.mkpath(QStringLiteral(".")))
+        return false;
+
+    const int tile = tileCells();
+    const int columns = (width + tile - 1) / tile;
+    const int rows = (height + tile - 1) / tile;
+
+    // Полоса - строка плиток; полосы независимы и идут в общем пуле
+    std::vector<int> strips(rows);
+    std::iota(strips.begin(), strips.end(), 0);
+
+    std::atomic<bool> completed { true };
+    QtConcurrent::blockingMap(strips, [&](int &row) {
+        TRACE_SPAN("export", "strip");
+
+        for (int column = 0; column < columns && completed; ++column) {
+            if (token.isCancelled()) {
+                completed = false;
+                return;
+            }
+
+            QImage image = render(QRect(column * tile, row * tile, tile, tile));
+            QString name = QStringLiteral("tile_%1_%2.png").arg(row).arg(column);
+            if (image.isNull() || !image.save(dir.filePath(name), "PNG", PNG_QUALITY)) {
+                qWarning() << "GridExporter: не удалось записать плитку" << name;
+                completed = false;
+            }
+        }
+    });
+
+    if (!completed)
+        return false;
+
+    QJsonArray tiles;
+    for (int row = 0; row < rows; ++row) {
+        for (int column = 0; column < columns; ++column) {
+            QRect cells = QRect(column * tile, row * tile, tile, tile)
+                              .intersected(QRect(0, 0, width, height));
+            tiles.append(QJsonObject {
+                { "file", QStringLiteral("tile_%1_%2.png").arg(row).arg(column) },
+                { "row", row },
+                { "column", column },
+                { "x", cells.left() },
+                { "y", cells.top() },
+                { "width", cells.width() },
+                { "height", cells.height() },
+            });
+        }
+    }
+
+    QJsonObject index {
+        { "version", INDEX_VERSION },
+        { "width", width },
+        { "height", height },
+        { "cellSize", m_cellSize },
+        { "tileCells", tile },
+        { "rows", rows },
+        { "columns", columns },
+        { "tiles", tiles },
+    };
+
+    QFile file(dir.filePath(QStringLiteral("index.json")));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    QByteArray json = QJsonDocument(index).toJson(QJsonDocument::Compact);
+    return file.write(json) == json.size();
+}
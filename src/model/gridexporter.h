@@ -0,0 +1,64 @@
+#ifndef GRIDEXPORTER_H
+#define GRIDEXPORTER_H
+
+#include <QImage>
+#include <QRect>
+#include <QString>
+
+#include <vector>
+
+#include "cancellationtoken.h"
+#include "compactpath.h"
+#include "flowfield.h"
+#include "gridmodel.h"
+
+// Отрисовка карты в изображения без сцены и без дисплея: пиксели пишутся
+// прямо из блоков модели в QImage с палитрой (байт на пиксель), поверх
+// накладываются пути. Большая карта режется на плитки PNG; полосы плиток
+// рисуются и сжимаются параллельно, рядом пишется index.json с раскладкой.
+class GridExporter final {
+
+    static constexpr int DEFAULT_TILE_px = 1024;
+    // Качество для PNG - обратная степень сжатия: быстрее, файл крупнее
+    static constexpr int PNG_QUALITY = 80;
+
+public:
+    explicit GridExporter(const GridModel *model);
+
+    // Сторона клетки в пикселях
+    void setCellSize(int pixels);
+    // Сторона плитки в пикселях, округляется до целого числа клеток
+    void setTileSize(int pixels);
+
+    void addPath(PathPtr path);
+    // Подсветка клеток, из которых достижима цель поля (PathFinder::flowFieldAsync);
+    // поле другого размера не рисуется
+    void setReachable(FlowFieldPtr field);
+
+    // Область карты в клетках одним изображением
+    QImage render(const QRect &cells) const;
+
+    // Плитки tile_<строка>_<столбец>.png и index.json в directory.
+    // Возвращает false при ошибке записи или отмене
+    bool exportTiles(const QString &directory,
+                     const CancellationToken &token = CancellationToken()) const;
+
+private:
+    const GridModel *m_model;
+
+    int m_cellSize = 1;
+    int m_tileSize = DEFAULT_TILE_px;
+
+    struct PathEntry {
+        PathPtr path;
+        // Рамка пути в клетках: плитки вне нее путь не обходят
+        QRect bounds;
+    };
+
+    std::vector<PathEntry> m_paths;
+    FlowFieldPtr m_reachable;
+
+    int tileCells() const;
+};
+
+#endif // GRIDEXPORTER_H
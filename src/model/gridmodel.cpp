@@ -1,8 +1,10 @@
+#include <algorithm>
 #include <random>
 
 #include "gridmodel.h"
 
 GridModel::GridModel(QObject *parent) : QObject(parent) {
+    qRegisterMetaType<GridDelta>("GridDelta");
 }
 
 void GridModel::initialize(int width, int height) {
@@ -21,18 +23,16 @@ void GridModel::initialize(int width, int height) {
     m_width = width;
     m_height = height;
 
-    m_grid.clear();
-    m_grid.resize(m_height);
-    for (int i = 0; i < m_height; ++i) {
-        m_grid[i].resize(m_width);
-        for (int j = 0; j < m_width; ++j) {
-            m_grid[i][j] = CellType::Empty;
-        }
-    }
+    // Незавершенная правка относится к старой карте
+    discardEdit();
+    ++m_version;
+
+    m_grid.reset(m_width, m_height, CellType::Empty);
 
     m_start = QPoint(-1, -1);
     m_end = QPoint(-1, -1);
 
+    emit layoutChanged();
     emit gridChanged();
 }
 
@@ -41,12 +41,27 @@ void GridModel::generateRandomWalls(double wallProbability) {
     std::mt19937 gen(rd());
     std::uniform_real_distribution<> dis(0.0, 1.0);
 
-    for (int y = 0; y < m_height; ++y) {
-        for (int x = 0; x < m_width; ++x) {
-            if (dis(gen) < wallProbability)
-                m_grid[y][x] = CellType::Wall;
-            else
-                m_grid[y][x] = CellType::Empty;
+    discardEdit();
+    ++m_version;
+
+    // Генерируем поблочно: на больших картах лишние блоки уходят в подкачку
+    ChunkedGrid::ChunkData chunk(ChunkedGrid::CHUNK_CELLS);
+    for (int cy = 0; cy < m_grid.chunksY(); ++cy) {
+        for (int cx = 0; cx < m_grid.chunksX(); ++cx) {
+            std::fill(chunk.begin(), chunk.end(), static_cast<uint8_t>(CellType::Empty));
+
+            int baseX = cx * ChunkedGrid::CHUNK_SIZE;
+            int baseY = cy * ChunkedGrid::CHUNK_SIZE;
+            int sizeX = std::min(ChunkedGrid::CHUNK_SIZE, m_width - baseX);
+            int sizeY = std::min(ChunkedGrid::CHUNK_SIZE, m_height - baseY);
+
+            for (int y = 0; y < sizeY; ++y) {
+                for (int x = 0; x < sizeX; ++x) {
+                    if (dis(gen) < wallProbability)
+                        chunk[(y << ChunkedGrid::CHUNK_SHIFT) | x] = static_cast<uint8_t>(CellType::Wall);
+                }
+            }
+            m_grid.storeChunk(cx, cy, chunk);
         }
     }
 
@@ -58,19 +73,76 @@ void GridModel::generateRandomWalls(double wallProbability) {
         m_end = QPoint(-1, -1);
         emit endPointChanged(m_end);
     }
+    emit layoutChanged();
     emit gridChanged();
 }
 
+void GridModel::beginEdit() {
+    ++m_editDepth;
+}
+
+void GridModel::commitEdit() {
+    if (m_editDepth == 0)
+        return;
+
+    if (--m_editDepth == 0)
+        publishEdit();
+}
+
 void GridModel::setCell(int x, int y, CellType type) {
-    if (x >= 0 && x < m_width && y >= 0 && y < m_height) {
-        m_grid[y][x] = type;
+    beginEdit();
+    writeCell(x, y, type);
+    commitEdit();
+}
+
+quint64 GridModel::version() const {
+    return m_version;
+}
+
+void GridModel::writeCell(int x, int y, CellType type) {
+    if (x < 0 || x >= m_width || y < 0 || y >= m_height)
+        return;
+
+    CellType previous = m_grid.cell(x, y);
+    if (previous == type)
+        return;
+
+    m_grid.setCell(x, y, type);
+    m_pendingDelta.region = m_pendingDelta.region.united(QRect(x, y, 1, 1));
+
+    // Запоминается только первое состояние клетки в правке
+    m_editedCells.emplace(y * m_width + x, previous != CellType::Wall);
+}
+
+void GridModel::publishEdit() {
+    if (m_pendingDelta.region.isNull())
+        return;
+
+    GridDelta delta = std::move(m_pendingDelta);
+    m_pendingDelta = GridDelta();
+
+    // Клетка, переключенная внутри правки обратно, в итог не попадает:
+    // списки описывают разницу между версиями, а не историю
+    for (const auto &[index, wasWalkable] : m_editedCells) {
+        int x = index % m_width;
+        int y = index / m_width;
+        bool walkable = isWalkable(x, y);
+        if (walkable != wasWalkable)
+            (walkable ? delta.opened : delta.closed).push_back(QPoint(x, y));
     }
+    m_editedCells.clear();
+
+    delta.version = ++m_version;
+    emit cellsChanged(delta);
+}
+
+void GridModel::discardEdit() {
+    m_pendingDelta = GridDelta();
+    m_editedCells.clear();
 }
 
 CellType GridModel::getCell(int x, int y) const {
-    if (x >= 0 && x < m_width && y >= 0 && y < m_height)
-        return m_grid[y][x];
-    return CellType::Wall;
+    return m_grid.cell(x, y);
 }
 
 int GridModel::width() const {
@@ -90,11 +162,13 @@ QPoint GridModel::endPoint() const {
 }
 
 void GridModel::clearPoints() {
+    GridEditTransaction transaction(this);
+
     if (isValidPoint(m_start)) {
-        m_grid[m_start.y()][m_start.x()] = CellType::Empty;
+        writeCell(m_start.x(), m_start.y(), CellType::Empty);
     }
     if (isValidPoint(m_end)) {
-        m_grid[m_end.y()][m_end.x()] = CellType::Empty;
+        writeCell(m_end.x(), m_end.y(), CellType::Empty);
     }
 
     m_start = QPoint(-1, -1);
@@ -102,35 +176,35 @@ void GridModel::clearPoints() {
 
     emit startPointChanged(m_start);
     emit endPointChanged(m_end);
-    emit gridChanged();
 }
 
 void GridModel::setStartPoint(const QPoint &point) {
 
     if (isValidPoint(point) && isWalkable(point.x(), point.y())) {
+        GridEditTransaction transaction(this);
+
         if (isValidPoint(m_start))
-            m_grid[m_start.y()][m_start.x()] = CellType::Empty;
+            writeCell(m_start.x(), m_start.y(), CellType::Empty);
 
         m_start = point;
-        m_grid[point.y()][point.x()] = CellType::Start;
+        writeCell(point.x(), point.y(), CellType::Start);
 
         emit startPointChanged(point);
-        emit gridChanged();
     }
 }
 
 void GridModel::setEndPoint(const QPoint &point) {
 
     if (isValidPoint(point) && isWalkable(point.x(), point.y())) {
+        GridEditTransaction transaction(this);
 
         if (isValidPoint(m_end))
-            m_grid[m_end.y()][m_end.x()] = CellType::Empty;
+            writeCell(m_end.x(), m_end.y(), CellType::Empty);
 
         m_end = point;
-        m_grid[point.y()][point.x()] = CellType::End;
+        writeCell(point.x(), point.y(), CellType::End);
 
         emit endPointChanged(point);
-        emit gridChanged();
     }
 }
 
@@ -148,7 +222,62 @@ bool GridModel::isValidPoint(const QPoint &point) const {
 }
 
 bool GridModel::isWalkable(int x, int y) const {
-    if (x < 0 || x >= m_width || y < 0 || y >= m_height)
+    return m_grid.cell(x, y) != CellType::Wall;
+}
+
+ChunkedGrid::Cursor GridModel::cursor() const {
+    return ChunkedGrid::Cursor(m_grid);
+}
+
+bool GridModel::saveWorld(const QString &path) {
+    // Точки A/Б - состояние сеанса, в файл мира они не попадают
+    if (isValidPoint(m_start))
+        m_grid.setCell(m_start.x(), m_start.y(), CellType::Empty);
+    if (isValidPoint(m_end))
+        m_grid.setCell(m_end.x(), m_end.y(), CellType::Empty);
+
+    bool saved = m_grid.save(path);
+
+    if (isValidPoint(m_start))
+        m_grid.setCell(m_start.x(), m_start.y(), CellType::Start);
+    if (isValidPoint(m_end))
+        m_grid.setCell(m_end.x(), m_end.y(), CellType::End);
+
+    return saved;
+}
+
+quint64 GridModel::worldStamp() const {
+    return m_grid.stamp();
+}
+
+bool GridModel::loadWorld(const QString &path) {
+    if (!m_grid.open(path, MAX_WIDTH_cnt, MAX_HEIGHT_cnt))
         return false;
-    return m_grid[y][x] != CellType::Wall;
+
+    m_width = m_grid.width();
+    m_height = m_grid.height();
+
+    discardEdit();
+    ++m_version;
+
+    m_start = QPoint(-1, -1);
+    m_end = QPoint(-1, -1);
+
+    emit startPointChanged(m_start);
+    emit endPointChanged(m_end);
+    emit layoutChanged();
+    emit gridChanged();
+    return true;
+}
+
+void GridModel::setResidentChunkLimit(size_t chunks) {
+    m_grid.setResidentLimit(chunks);
+}
+
+GridEditTransaction::GridEditTransaction(GridModel *model) : m_model(model) {
+    m_model->beginEdit();
+}
+
+GridEditTransaction::~GridEditTransaction() {
+    m_model->commitEdit();
 }
@@ -3,37 +3,56 @@
 
 #include <QObject>
 #include <QPoint>
+#include <QRect>
+#include <QString>
 
+#include <atomic>
+#include <unordered_map>
 #include <vector>
 
-enum class CellType {
-    Empty,
-    Wall,
-    Start,
-    End,
-    Path,
-    Visited
+#include "celltype.h"
+#include "chunkedgrid.h"
+
+// Итог одной правки (транзакции): все изменившиеся клетки и отдельно
+// клетки, сменившие проходимость, - для производных индексов
+struct GridDelta {
+    quint64 version = 0;
+    QRect region;
+    std::vector<QPoint> opened;
+    std::vector<QPoint> closed;
 };
 
 class GridModel final : public QObject {
     Q_OBJECT
 
-    static constexpr int8_t MAX_WIDTH_cnt = 100;
-    static constexpr int8_t MAX_HEIGHT_cnt = 100;
-
-    static constexpr int8_t MIN_WIDTH_cnt = 1;
-    static constexpr int8_t MIN_HEIGHT_cnt = 1;
+    static constexpr int MIN_WIDTH_cnt = 1;
+    static constexpr int MIN_HEIGHT_cnt = 1;
 
 public:
+    // Предел задают индексы клеток в поиске (int), а не память:
+    // хранилище блочное и выгружает лишнее на диск
+    static constexpr int MAX_WIDTH_cnt = 16384;
+    static constexpr int MAX_HEIGHT_cnt = 16384;
+
     GridModel(QObject *parent = nullptr);
 
     void initialize(int width, int height);
 
     void generateRandomWalls(double wallProbability = 0.3);
 
+    // Правки между beginEdit и commitEdit дают одно уведомление cellsChanged
+    // и одно изменение версии. Транзакции могут быть вложенными, изменения
+    // публикуются при закрытии внешней. Вне транзакции каждая правка - своя
+    // транзакция. См. также GridEditTransaction
+    void beginEdit();
+    void commitEdit();
+
     void setCell(int x, int y, CellType type);
     CellType getCell(int x, int y) const;
 
+    // Номер версии клеток, растет на каждую опубликованную правку
+    quint64 version() const;
+
     int width() const;
     int height() const;
 
@@ -51,19 +70,63 @@ public:
     bool isValidPoint(const QPoint &point) const;
     bool isWalkable(int x, int y) const;
 
+    // Курсор для поиска: подтягивает блоки карты по мере обхода
+    ChunkedGrid::Cursor cursor() const;
+
+    // Мир в файле блоков: открытый мир подгружается по мере обращения
+    bool saveWorld(const QString &path);
+    bool loadWorld(const QString &path);
+    // Отметка последнего сохраненного или подключенного файла мира
+    quint64 worldStamp() const;
+    void setResidentChunkLimit(size_t chunks);
+
 signals:
     void gridChanged();
+    // Проходимость изменилась целиком: новая карта или перегенерация стен
+    void layoutChanged();
+    // Опубликована правка отдельных клеток (setCell, точки А/Б)
+    void cellsChanged(const GridDelta &delta);
     void startPointChanged(const QPoint &point);
     void endPointChanged(const QPoint &point);
 
 private:
-    int m_width = 0;
-    int m_height = 0;
+    // Читаются и из потоков пула; размер вместе с содержимым карты
+    // согласованно дает только курсор
+    std::atomic<int> m_width { 0 };
+    std::atomic<int> m_height { 0 };
 
-    std::vector<std::vector<CellType>> m_grid;
+    ChunkedGrid m_grid;
 
     QPoint m_start = QPoint(-1, -1);
     QPoint m_end = QPoint(-1, -1);
+
+    quint64 m_version = 0;
+    int m_editDepth = 0;
+    GridDelta m_pendingDelta;
+    // Проходимость затронутых правкой клеток до ее начала, ключ - y * width + x.
+    // Списки opened/closed собираются при публикации из итогового состояния
+    std::unordered_map<int, bool> m_editedCells;
+
+    void writeCell(int x, int y, CellType type);
+    void publishEdit();
+    void discardEdit();
 };
 
+// Транзакция правки в стиле RAII: открывается в конструкторе,
+// публикуется в деструкторе
+class GridEditTransaction final {
+
+public:
+    explicit GridEditTransaction(GridModel *model);
+    ~GridEditTransaction();
+
+    GridEditTransaction(const GridEditTransaction &) = delete;
+    GridEditTransaction &operator=(const GridEditTransaction &) = delete;
+
+private:
+    GridModel *m_model;
+};
+
+Q_DECLARE_METATYPE(GridDelta)
+
 #endif // GRIDMODEL_H
@@ -0,0 +1,282 @@
+#include <QDataStream>
+#include <QIODevice>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+
+#include "direction.h"
+#include "gridmodel.h"
+#include "landmarktable.h"
+
+namespace {
+
+constexpr quint32 FILE_MAGIC = 0x4C4D4B31; // "LMK1"
+constexpr quint16 FILE_VERSION = 1;
+constexpr quint32 MAX_LANDMARK_cnt = 64;
+
+// Как часто BFS ориентира проверяет отмену, в извлеченных клетках
+constexpr size_t STOP_CHECK_INTERVAL_cnt = 4096;
+
+int paddedIndex(const PaddedMask &walkable, int x, int y) {
+    return (y + 1) * walkable.stride() + x + 1;
+}
+
+} // namespace
+
+LandmarkTable::LandmarkTable(int width, int height, std::vector<QPoint> landmarks)
+    : m_width(width), m_height(height), m_landmarks(std::move(landmarks)) {
+
+    m_distances.assign(static_cast<size_t>(width) * height * m_landmarks.size(), UNREACHABLE);
+}
+
+std::shared_ptr<LandmarkTable> LandmarkTable::build(const PaddedMask &walkable, int count,
+                                                    const CancellationToken &token) {
+    const int width = walkable.width();
+    const int height = walkable.height();
+
+    int seed = -1;
+    for (int y = 0; y < height && seed < 0; ++y) {
+        for (int x = 0; x < width; ++x) {
+            if (walkable.isWalkable(paddedIndex(walkable, x, y), x, y)) {
+                seed = y * width + x;
+                break;
+            }
+        }
+    }
+    if (seed < 0 || count <= 0)
+        return std::shared_ptr<LandmarkTable>(new LandmarkTable(width, height, {}));
+
+    count = std::min<int>(count, MAX_LANDMARK_cnt);
+
+    // Выбор самой дальней точкой последователен: каждый следующий ориентир
+    // зависит от предыдущих. Для выбора хватает одного массива - расстояния
+    // до ближайшего из выбранных. Первый ориентир - самая дальняя клетка
+    // от затравки
+    const size_t cells = static_cast<size_t>(width) * height;
+    std::vector<uint16_t> nearest(cells, UNREACHABLE);
+    if (!relaxNearest(walkable, seed, nearest, token))
+        return nullptr;
+
+    int next = pickFarthest(walkable, nearest);
+    if (next < 0)
+        next = seed;
+    std::fill(nearest.begin(), nearest.end(), UNREACHABLE);
+
+    std::vector<QPoint> landmarks;
+    while (next >= 0 && static_cast<int>(landmarks.size()) < count) {
+        landmarks.push_back(QPoint(next % width, next / width));
+        if (static_cast<int>(landmarks.size()) == count)
+            break;
+
+        if (!relaxNearest(walkable, next, nearest, token))
+            return nullptr;
+        next = pickFarthest(walkable, nearest);
+    }
+    nearest = std::vector<uint16_t>();
+
+    // Проходимых клеток может быть меньше, чем ориентиров
+    auto table = std::shared_ptr<LandmarkTable>(
+        new LandmarkTable(width, height, std::move(landmarks)));
+    if (!table->computeAll(walkable, token))
+        return nullptr;
+    return table;
+}
+
+std::shared_ptr<LandmarkTable> LandmarkTable::rebuild(const LandmarkTable &previous,
+                                                      const PaddedMask &walkable,
+                                                      const CancellationToken &token) {
+    auto table = std::shared_ptr<LandmarkTable>(
+        new LandmarkTable(previous.m_width, previous.m_height, previous.m_landmarks));
+
+    if (!table->computeAll(walkable, token))
+        return nullptr;
+    return table;
+}
+
+bool LandmarkTable::computeAll(const PaddedMask &walkable, const CancellationToken &token) {
+    std::vector<int> order(m_landmarks.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    // Ориентиры независимы: считаем их BFS параллельно в общем пуле,
+    // каждый пишет только свой столбец
+    std::atomic<bool> completed { true };
+    QtConcurrent::blockingMap(order, [&](int &landmark) {
+        if (!computeDistances(walkable, landmark, token))
+            completed = false;
+    });
+    return completed;
+}
+
+bool LandmarkTable::computeDistances(const PaddedMask &walkable, int landmark,
+                                     const CancellationToken &token) {
+    const size_t count = m_landmarks.size();
+    const size_t cells = static_cast<size_t>(m_width) * m_height;
+    uint16_t *column = m_distances.data() + landmark;
+
+    for (size_t i = 0; i < cells; ++i)
+        column[i * count] = UNREACHABLE;
+
+    std::vector<uint32_t> queue;
+
+    const QPoint &source = m_landmarks[landmark];
+    const int sourceIndex = source.y() * m_width + source.x();
+    column[sourceIndex * count] = 0;
+    queue.push_back(sourceIndex);
+
+    for (size_t head = 0; head < queue.size(); ++head) {
+        if (head % STOP_CHECK_INTERVAL_cnt == 0 && token.isCancelled())
+            return false;
+
+        const int current = queue[head];
+        const int cx = current % m_width;
+        const int cy = current / m_width;
+        const uint16_t next = std::min<int>(column[current * count] + 1, MAX_DISTANCE);
+
+        // Рамка маски непроходима, проверка границ не нужна
+        for (uint8_t dir = 0; dir < Direction::COUNT; ++dir) {
+            const int nx = cx + Direction::DX[dir];
+            const int ny = cy + Direction::DY[dir];
+            if (!walkable.isWalkable(paddedIndex(walkable, nx, ny), nx, ny))
+                continue;
+
+            const size_t neighbor = static_cast<size_t>(ny) * m_width + nx;
+            if (column[neighbor * count] == UNREACHABLE) {
+                column[neighbor * count] = next;
+                queue.push_back(static_cast<uint32_t>(neighbor));
+            }
+        }
+    }
+    return true;
+}
+
+bool LandmarkTable::relaxNearest(const PaddedMask &walkable, int source,
+                                 std::vector<uint16_t> &nearest, const CancellationToken &token) {
+    const int width = walkable.width();
+    std::vector<uint32_t> queue;
+
+    nearest[source] = 0;
+    queue.push_back(source);
+
+    // BFS от нового ориентира идет только туда, где он ближе прежних:
+    // дальше такой клетки он тоже не ближе
+    for (size_t head = 0; head < queue.size(); ++head) {
+        if (head % STOP_CHECK_INTERVAL_cnt == 0 && token.isCancelled())
+            return false;
+
+        const int current = queue[head];
+        const int cx = current % width;
+        const int cy = current / width;
+        const uint16_t next = std::min<int>(nearest[current] + 1, MAX_DISTANCE);
+
+        for (uint8_t dir = 0; dir < Direction::COUNT; ++dir) {
+            const int nx = cx + Direction::DX[dir];
+            const int ny = cy + Direction::DY[dir];
+            if (!walkable.isWalkable(paddedIndex(walkable, nx, ny), nx, ny))
+                continue;
+
+            const size_t neighbor = static_cast<size_t>(ny) * width + nx;
+            if (next < nearest[neighbor]) {
+                nearest[neighbor] = next;
+                queue.push_back(static_cast<uint32_t>(neighbor));
+            }
+        }
+    }
+    return true;
+}
+
+int LandmarkTable::pickFarthest(const PaddedMask &walkable, const std::vector<uint16_t> &nearest) {
+    const int width = walkable.width();
+    const int height = walkable.height();
+
+    // UNREACHABLE считается самым дальним, поэтому непокрытые компоненты
+    // связности выбираются первыми
+    int best = -1;
+    uint16_t bestValue = 0;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            if (!walkable.isWalkable(paddedIndex(walkable, x, y), x, y))
+                continue;
+
+            const int index = y * width + x;
+            if (nearest[index] > bestValue) {
+                bestValue = nearest[index];
+                best = index;
+            }
+        }
+    }
+    return best;
+}
+
+bool LandmarkTable::save(QIODevice *device) const {
+    QDataStream stream(device);
+
+    stream << FILE_MAGIC << FILE_VERSION;
+    stream << qint32(m_width) << qint32(m_height) << quint32(m_landmarks.size());
+
+    for (const auto &landmark : m_landmarks)
+        stream << landmark;
+    for (uint16_t distance : m_distances)
+        stream << quint16(distance);
+
+    return stream.status() == QDataStream::Ok;
+}
+
+std::shared_ptr<LandmarkTable> LandmarkTable::load(QIODevice *device) {
+    QDataStream stream(device);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    stream >> magic >> version;
+    if (magic != FILE_MAGIC || version != FILE_VERSION)
+        return nullptr;
+
+    qint32 width = 0;
+    qint32 height = 0;
+    quint32 count = 0;
+    stream >> width >> height >> count;
+    if (stream.status() != QDataStream::Ok || width <= 0 || height <= 0 ||
+        width > GridModel::MAX_WIDTH_cnt || height > GridModel::MAX_HEIGHT_cnt ||
+        count > MAX_LANDMARK_cnt)
+        return nullptr;
+
+    // Размер таблицы - из файла: память выделяется, только если данные
+    // действительно есть в файле
+    const qint64 pointsSize = qint64(count) * 2 * sizeof(qint32);
+    const qint64 distancesSize = qint64(width) * height * count * sizeof(quint16);
+    if (device->bytesAvailable() < pointsSize + distancesSize)
+        return nullptr;
+
+    std::vector<QPoint> landmarks(count);
+    for (auto &landmark : landmarks) {
+        stream >> landmark;
+        // От ориентиров идет пересчет BFS, они должны лежать на карте
+        if (landmark.x() < 0 || landmark.x() >= width ||
+            landmark.y() < 0 || landmark.y() >= height)
+            return nullptr;
+    }
+
+    auto table = std::shared_ptr<LandmarkTable>(new LandmarkTable(width, height, std::move(landmarks)));
+    for (auto &distance : table->m_distances) {
+        quint16 value = 0;
+        stream >> value;
+        distance = value;
+    }
+
+    if (stream.status() != QDataStream::Ok)
+        return nullptr;
+    return table;
+}
+
+int LandmarkTable::width() const {
+    return m_width;
+}
+
+int LandmarkTable::height() const {
+    return m_height;
+}
+
+const std::vector<QPoint> &LandmarkTable::landmarks() const {
+    return m_landmarks;
+}
@@ -0,0 +1,91 @@
+#ifndef LANDMARKTABLE_H
+#define LANDMARKTABLE_H
+
+#include <QPoint>
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "cancellationtoken.h"
+#include "paddedmask.h"
+
+class QIODevice;
+
+// Предрасчет для эвристики ALT (A* + ориентиры + неравенство треугольника).
+// Для K ориентиров хранятся BFS-расстояния до каждой клетки, 16 бит на
+// значение. Для клетки n и цели t оценка max |d(L, t) - d(L, n)| допустима
+// и согласована, поэтому A* с ней не переоткрывает вершины.
+//
+// Таблица переживает добавление стен: расстояния только растут, и старые
+// значения остаются нижней оценкой. После открытия клетки таблицу нужно
+// пересчитать (rebuild), ориентиры при этом сохраняются.
+class LandmarkTable final {
+
+public:
+    static constexpr uint16_t UNREACHABLE = 0xFFFF;
+    // Дальние расстояния насыщаются: разность насыщенных значений
+    // не превышает исходную, так что оценка остается допустимой
+    static constexpr uint16_t MAX_DISTANCE = 0xFFFE;
+
+    // Выбор ориентиров методом самой дальней точки (последовательно) и расчет
+    // их расстояний по снимку проходимости, по ориентиру на поток.
+    // Возвращает nullptr, если расчет отменен
+    static std::shared_ptr<LandmarkTable> build(const PaddedMask &walkable, int count,
+                                                const CancellationToken &token);
+
+    // Пересчет расстояний для прежних ориентиров, по ориентиру на поток
+    static std::shared_ptr<LandmarkTable> rebuild(const LandmarkTable &previous,
+                                                  const PaddedMask &walkable,
+                                                  const CancellationToken &token);
+
+    bool save(QIODevice *device) const;
+    static std::shared_ptr<LandmarkTable> load(QIODevice *device);
+
+    int width() const;
+    int height() const;
+    const std::vector<QPoint> &landmarks() const;
+
+    int heuristic(int index, int goalIndex) const {
+        const size_t count = m_landmarks.size();
+        const uint16_t *from = &m_distances[index * count];
+        const uint16_t *to = &m_distances[goalIndex * count];
+
+        int best = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (from[i] == UNREACHABLE || to[i] == UNREACHABLE)
+                continue;
+            int diff = std::abs(static_cast<int>(to[i]) - static_cast<int>(from[i]));
+            if (diff > best)
+                best = diff;
+        }
+        return best;
+    }
+
+private:
+    LandmarkTable(int width, int height, std::vector<QPoint> landmarks);
+
+    // Столбцы всех ориентиров параллельно в общем пуле
+    bool computeAll(const PaddedMask &walkable, const CancellationToken &token);
+    // BFS от ориентира сразу в его столбец таблицы, без промежуточного массива
+    bool computeDistances(const PaddedMask &walkable, int landmark,
+                          const CancellationToken &token);
+
+    // Выбор ориентиров: nearest - расстояние до ближайшего из выбранных,
+    // relaxNearest добавляет к ним source
+    static bool relaxNearest(const PaddedMask &walkable, int source,
+                             std::vector<uint16_t> &nearest, const CancellationToken &token);
+    // Проходимая клетка, самая дальняя от выбранных ориентиров, или -1
+    static int pickFarthest(const PaddedMask &walkable, const std::vector<uint16_t> &nearest);
+
+    int m_width = 0;
+    int m_height = 0;
+
+    std::vector<QPoint> m_landmarks;
+    // Расстояния по клеткам, внутри клетки - по ориентирам:
+    // эвристика читает одну короткую строку вместо K массивов
+    std::vector<uint16_t> m_distances;
+};
+
+#endif // LANDMARKTABLE_H
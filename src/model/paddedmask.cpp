@@ -0,0 +1,20 @@
+#include "paddedmask.h"
+
+PaddedMask::PaddedMask(ChunkedGrid::Cursor &cells, int width, int height)
+    : m_width(width), m_height(height) {
+
+    m_cells.assign(static_cast<size_t>(width + 2) * (height + 2), 0);
+
+    for (int y = 0; y < height; ++y) {
+        uint8_t *row = m_cells.data() + static_cast<size_t>(y + 1) * stride() + 1;
+        for (int x = 0; x < width; ++x)
+            row[x] = cells.isWalkable(x, y);
+    }
+}
+
+void PaddedMask::patch(const std::vector<QPoint> &opened, const std::vector<QPoint> &closed) {
+    for (const auto &point : opened)
+        m_cells[(point.y() + 1) * stride() + point.x() + 1] = 1;
+    for (const auto &point : closed)
+        m_cells[(point.y() + 1) * stride() + point.x() + 1] = 0;
+}
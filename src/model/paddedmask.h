@@ -0,0 +1,54 @@
+#ifndef PADDEDMASK_H
+#define PADDEDMASK_H
+
+#include <QPoint>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "chunkedgrid.h"
+
+// Плотная маска проходимости с непроходимой рамкой в одну клетку.
+// Индекс клетки (x, y) - (y + 1) * stride() + (x + 1): у любой клетки карты
+// все восемь соседей лежат внутри массива, и поиск обходится без проверок
+// границ (см. searchkernel.h).
+//
+// Опубликованная маска неизменяема: владелец правит ее на месте (patch),
+// только пока снимок не отдан запросам, иначе сначала копирует. Запросы
+// в других потоках читают свой снимок без блокировок.
+class PaddedMask final {
+
+public:
+    // Снимок карты width x height, прочитанной через курсор
+    PaddedMask(ChunkedGrid::Cursor &cells, int width, int height);
+
+    void patch(const std::vector<QPoint> &opened, const std::vector<QPoint> &closed);
+
+    int width() const {
+        return m_width;
+    }
+
+    int height() const {
+        return m_height;
+    }
+
+    int stride() const {
+        return m_width + 2;
+    }
+
+    // Сигнатура общая с курсором блочной карты, координаты маске не нужны
+    bool isWalkable(int index, int x, int y) const {
+        Q_UNUSED(x);
+        Q_UNUSED(y);
+        return m_cells[index];
+    }
+
+private:
+    int m_width = 0;
+    int m_height = 0;
+
+    std::vector<uint8_t> m_cells;
+};
+
+#endif // PADDEDMASK_H
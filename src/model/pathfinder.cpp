@@ -1,16 +1,267 @@
 #include "pathfinder.h"
-#include <queue>
+#include <algorithm>
+#include <cstdlib>
 #include <vector>
 #include <QDebug>
+#include <QPromise>
+#include <QtConcurrent>
+
+#include "direction.h"
+#include "searchkernel.h"
+#include "searchworkspace.h"
+#include "tracing.h"
+
+namespace {
+
+// В клетке хранится направление шага, которым в нее пришли:
+// откатываемся против него до стартовой клетки, сразу собирая серии
+PathPtr reconstructPath(const SearchWorkspace &workspace, int current) {
+    std::vector<uint32_t> runs;
+
+    int stride = workspace.width();
+    int x = current % stride - 1;
+    int y = current / stride - 1;
+
+    uint8_t runDir = Direction::NONE;
+    uint32_t runLength = 0;
+
+    for (;;) {
+        uint8_t dir = workspace.cameFrom(SearchKernel::paddedIndex(x, y, stride));
+        if (dir != runDir || runLength == CompactPath::MAX_RUN_LENGTH) {
+            if (runLength > 0)
+                runs.push_back(CompactPath::encodeRun(runDir, runLength));
+            runDir = dir;
+            runLength = 0;
+        }
+        if (dir == Direction::NONE)
+            break;
+
+        ++runLength;
+        x -= Direction::DX[dir];
+        y -= Direction::DY[dir];
+    }
+
+    std::reverse(runs.begin(), runs.end());
+    return std::make_shared<const CompactPath>(QPoint(x, y), std::move(runs));
+}
+
+// Выбор специализации ядра - один раз на запрос, дальше цикл поиска
+// не ветвится по настройкам
+template <typename Storage>
+PathPtr searchOn(Storage &storage, const QPoint &start, const QPoint &end,
+                 PathFinder::Connectivity connectivity, PathFinder::CostModel costModel,
+                 const LandmarkTable *landmarks, const PathFinder::StopCondition &shouldStop) {
+    using namespace SearchKernel;
+
+    int width = storage.width();
+    int stride = storage.stride();
+
+    // Рабочая область переиспользуется между запросами этого потока,
+    // подготовка не зависит от размера карты
+    SearchWorkspace &workspace = SearchWorkspace::local();
+    {
+        TRACE_SPAN("search", "prepare");
+        workspace.prepare(stride, storage.height() + 2);
+    }
+
+    int startIndex = paddedIndex(start.x(), start.y(), stride);
+    int endIndex = paddedIndex(end.x(), end.y(), stride);
+
+    bool found = false;
+    TRACE_SPAN("search", "kernel");
+
+    if (connectivity == PathFinder::Connectivity::Four) {
+        if (landmarks) {
+            int goal = end.y() * width + end.x();
+
+            // Обе оценки допустимы, берем более сильную
+            auto heuristic = [&](int x, int y) {
+                int manhattan = std::abs(x - end.x()) + std::abs(y - end.y());
+                return std::max(manhattan, landmarks->heuristic(y * width + x, goal));
+            };
+            found = bestFirst<FourConnected, UnitCost, DirectionCode>(
+                storage, workspace, startIndex, endIndex, heuristic, shouldStop);
+        } else {
+            found = breadthFirst<FourConnected, DirectionCode>(
+                storage, workspace, startIndex, endIndex, shouldStop);
+        }
+    } else if (costModel == PathFinder::CostModel::Unit) {
+        found = breadthFirst<EightConnected, DirectionCode>(
+            storage, workspace, startIndex, endIndex, shouldStop);
+    } else {
+        // Октильное расстояние: точная стоимость на пустой карте
+        auto heuristic = [&](int x, int y) {
+            int dx = std::abs(x - end.x());
+            int dy = std::abs(y - end.y());
+            return static_cast<int>(OctileCost::STRAIGHT) * std::max(dx, dy) +
+                   static_cast<int>(OctileCost::DIAGONAL - OctileCost::STRAIGHT) * std::min(dx, dy);
+        };
+        found = bestFirst<EightConnected, OctileCost, DirectionCode>(
+            storage, workspace, startIndex, endIndex, heuristic, shouldStop);
+    }
+
+    if (!found)
+        return nullptr;
+
+    TRACE_SPAN("search", "reconstruct");
+    return reconstructPath(workspace, endIndex);
+}
+
+// Поиск от старта до count ближайших целей. targets - индексы целей с рамкой,
+// отсортированы: проверка клетки - двоичный поиск, а не проход по всем целям
+template <typename Storage>
+std::vector<PathPtr> nearestOn(Storage &storage, const QPoint &start,
+                               const std::vector<int> &targets, int count,
+                               PathFinder::Connectivity connectivity,
+                               PathFinder::CostModel costModel,
+                               const PathFinder::StopCondition &shouldStop) {
+    using namespace SearchKernel;
+
+    const int stride = storage.stride();
+
+    SearchWorkspace &workspace = SearchWorkspace::local();
+    {
+        TRACE_SPAN("search", "prepare");
+        workspace.prepare(stride, storage.height() + 2);
+    }
+
+    // Цели приходят в порядке стоимости: BFS находит клетки по слоям,
+    // Дейкстра отдает клетку, когда ее стоимость окончательна
+    std::vector<int> reached;
+    auto reachedGoal = [&](int index) {
+        if (!std::binary_search(targets.begin(), targets.end(), index))
+            return false;
+        reached.push_back(index);
+        return static_cast<int>(reached.size()) == count;
+    };
+
+    const int startIndex = paddedIndex(start.x(), start.y(), stride);
+    {
+        TRACE_SPAN("search", "kernel");
+
+        if (connectivity == PathFinder::Connectivity::Four) {
+            breadthFirstUntil<FourConnected, DirectionCode>(
+                storage, workspace, startIndex, reachedGoal, shouldStop);
+        } else if (costModel == PathFinder::CostModel::Unit) {
+            breadthFirstUntil<EightConnected, DirectionCode>(
+                storage, workspace, startIndex, reachedGoal, shouldStop);
+        } else {
+            // Эвристика до ближайшей из многих целей стоила бы прохода по ним
+            // на каждом шаге, поэтому без нее
+            bestFirstUntil<EightConnected, OctileCost, DirectionCode>(
+                storage, workspace, startIndex, [](int, int) { return 0; },
+                reachedGoal, shouldStop);
+        }
+    }
+
+    if (shouldStop())
+        return {};
+
+    // Все пути - ветви одного дерева поиска
+    TRACE_SPAN("search", "reconstruct");
+    std::vector<PathPtr> paths;
+    paths.reserve(reached.size());
+    for (int index : reached)
+        paths.push_back(reconstructPath(workspace, index));
+    return paths;
+}
+
+// Обратный поиск от цели по всей достижимой области. Шаги симметричны,
+// поэтому направление, которым поиск пришел в клетку, развернутое -
+// следующий шаг из нее к цели
+template <typename Storage>
+FlowFieldPtr floodOn(Storage &storage, const QPoint &goal,
+                     PathFinder::Connectivity connectivity, PathFinder::CostModel costModel,
+                     const PathFinder::StopCondition &shouldStop) {
+    using namespace SearchKernel;
+
+    const int width = storage.width();
+    const int height = storage.height();
+    const int stride = storage.stride();
+
+    SearchWorkspace &workspace = SearchWorkspace::local();
+    {
+        TRACE_SPAN("search", "prepare");
+        workspace.prepare(stride, height + 2);
+    }
+
+    const int goalIndex = paddedIndex(goal.x(), goal.y(), stride);
+    {
+        TRACE_SPAN("search", "flood");
+
+        if (connectivity == PathFinder::Connectivity::Four) {
+            breadthFirst<FourConnected, DirectionCode>(
+                storage, workspace, goalIndex, -1, shouldStop);
+        } else if (costModel == PathFinder::CostModel::Unit) {
+            breadthFirst<EightConnected, DirectionCode>(
+                storage, workspace, goalIndex, -1, shouldStop);
+        } else {
+            // Без эвристики bestFirst - это Дейкстра
+            bestFirst<EightConnected, OctileCost, DirectionCode>(
+                storage, workspace, goalIndex, -1, [](int, int) { return 0; }, shouldStop);
+        }
+    }
+
+    // Обход всей области не "находит" цель, прерывание видно только здесь
+    if (shouldStop())
+        return nullptr;
+
+    TRACE_SPAN("search", "packField");
+
+    auto field = std::make_shared<FlowField>(
+        goal, width, height,
+        connectivity == PathFinder::Connectivity::Four ? Direction::COUNT
+                                                       : Direction::EXTENDED_COUNT);
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            int index = paddedIndex(x, y, stride);
+            if (!workspace.isVisited(index))
+                continue;
+
+            uint8_t dir = workspace.cameFrom(index);
+            if (dir != Direction::NONE)
+                field->setDirection(x, y, Direction::opposite(dir));
+        }
+    }
+    return field;
+}
+
+} // namespace
 
 PathFinder::PathFinder(GridModel *model, QObject *parent)
     : QObject(parent), m_model(model) {
 
+    qRegisterMetaType<PathPtr>("PathPtr");
+    qRegisterMetaType<WaypointPath>("WaypointPath");
+
+    // Снимок карты для ориентиров берется в потоке модели, в момент изменения
+    connect(m_model, &GridModel::layoutChanged, this,
+            &PathFinder::onLayoutChanged, Qt::DirectConnection);
+    connect(m_model, &GridModel::cellsChanged, this,
+            &PathFinder::onCellsChanged, Qt::DirectConnection);
+
+    // Карта могла быть загружена до создания поиска (headless-режимы)
+    if (m_model->width() > 0 && m_model->height() > 0)
+        onLayoutChanged();
+
+    m_workerThread.setObjectName("PathFinder worker");
     this->moveToThread(&m_workerThread);
     m_workerThread.start();
 }
 
 PathFinder::~PathFinder() {
+    {
+        QMutexLocker locker(&m_maskMutex);
+        m_maskToken.cancel();
+    }
+    {
+        QMutexLocker locker(&m_landmarksMutex);
+        m_landmarkToken.cancel();
+    }
+    m_queryPool.clear();
+    m_queryPool.waitForDone();
+
     if (m_workerThread.isRunning()) {
         m_workerThread.quit();
 
@@ -19,13 +270,182 @@ PathFinder::~PathFinder() {
     }
 }
 
+QFuture<PathPtr> PathFinder::findPathAsync(const QPoint &start, const QPoint &end,
+                                           const CancellationToken &token) {
+    // Время в очереди пула - от постановки запроса до начала его выполнения
+    quint64 traceId = TRACE_NEXT_ID();
+    TRACE_ASYNC_BEGIN("query", "queued", traceId);
+
+    return QtConcurrent::run(&m_queryPool,
+                             [this, start, end, token, traceId](QPromise<PathPtr> &promise) {
+        TRACE_ASYNC_END("query", "queued", traceId);
+        TRACE_SPAN("query", "findPathAsync");
+
+        auto shouldStop = [&promise, &token]() {
+            return promise.isCanceled() || token.isCancelled();
+        };
+
+        PathPtr path = search(start, end, shouldStop);
+
+        if (shouldStop())
+            promise.future().cancel();
+        else
+            promise.addResult(std::move(path));
+    });
+}
+
+QFuture<PathPtr> PathFinder::findPathsAsync(std::vector<PathQuery> queries,
+                                            const CancellationToken &token) {
+    quint64 traceId = TRACE_NEXT_ID();
+    TRACE_ASYNC_BEGIN("query", "queued", traceId);
+
+    return QtConcurrent::run(&m_queryPool, [this, queries = std::move(queries), token,
+                                            traceId](QPromise<PathPtr> &promise) {
+        TRACE_ASYNC_END("query", "queued", traceId);
+        TRACE_SPAN("query", "findPathsAsync");
+
+        auto shouldStop = [&promise, &token]() {
+            return promise.isCanceled() || token.isCancelled();
+        };
+
+        for (size_t i = 0; i < queries.size() && !shouldStop(); ++i) {
+            PathPtr path = search(queries[i].start, queries[i].end, shouldStop);
+            if (shouldStop())
+                break;
+            promise.addResult(std::move(path), static_cast<int>(i));
+        }
+
+        if (shouldStop())
+            promise.future().cancel();
+    });
+}
+
+QFuture<WaypointPath> PathFinder::findWaypointsAsync(std::vector<PathQuery> queries,
+                                                     PathSimplifier::Mode mode,
+                                                     const CancellationToken &token) {
+    quint64 traceId = TRACE_NEXT_ID();
+    TRACE_ASYNC_BEGIN("query", "queued", traceId);
+
+    return QtConcurrent::run(&m_queryPool, [this, queries = std::move(queries), mode, token,
+                                            traceId](QPromise<WaypointPath> &promise) {
+        TRACE_ASYNC_END("query", "queued", traceId);
+        TRACE_SPAN("query", "findWaypointsAsync");
+
+        auto shouldStop = [&promise, &token]() {
+            return promise.isCanceled() || token.isCancelled();
+        };
+
+        for (size_t i = 0; i < queries.size() && !shouldStop(); ++i) {
+            WaypointPath path = searchWaypoints(queries[i].start, queries[i].end, mode, shouldStop);
+            if (shouldStop())
+                break;
+            promise.addResult(std::move(path), static_cast<int>(i));
+        }
+
+        if (shouldStop())
+            promise.future().cancel();
+    });
+}
+
+QFuture<PathPtr> PathFinder::findNearestAsync(const QPoint &start, std::vector<QPoint> goals,
+                                              int count, const CancellationToken &token) {
+    quint64 traceId = TRACE_NEXT_ID();
+    TRACE_ASYNC_BEGIN("query", "queued", traceId);
+
+    return QtConcurrent::run(&m_queryPool, [this, start, goals = std::move(goals), count, token,
+                                            traceId](QPromise<PathPtr> &promise) {
+        TRACE_ASYNC_END("query", "queued", traceId);
+        TRACE_SPAN("query", "findNearestAsync");
+
+        auto shouldStop = [&promise, &token]() {
+            return promise.isCanceled() || token.isCancelled();
+        };
+
+        std::vector<PathPtr> paths = searchNearest(start, std::move(goals), count, shouldStop);
+
+        if (shouldStop()) {
+            promise.future().cancel();
+            return;
+        }
+        for (size_t i = 0; i < paths.size(); ++i)
+            promise.addResult(std::move(paths[i]), static_cast<int>(i));
+    });
+}
+
+QFuture<FlowFieldPtr> PathFinder::flowFieldAsync(const QPoint &goal,
+                                                 const CancellationToken &token) {
+    return QtConcurrent::run(&m_queryPool, [this, goal, token](QPromise<FlowFieldPtr> &promise) {
+        TRACE_SPAN("query", "flowFieldAsync");
+
+        auto shouldStop = [&promise, &token]() {
+            return promise.isCanceled() || token.isCancelled();
+        };
+
+        FlowFieldPtr field = flowField(goal, shouldStop);
+
+        if (shouldStop())
+            promise.future().cancel();
+        else
+            promise.addResult(std::move(field));
+    });
+}
+
+QFuture<FlowFieldPtr> PathFinder::flowFieldsAsync(std::vector<QPoint> goals,
+                                                  const CancellationToken &token) {
+    // Задача пула на цель: поля разных целей строятся одновременно. Обещание
+    // общее - отмену через QFuture видят все задачи, последняя его завершает
+    auto promise = std::make_shared<QPromise<FlowFieldPtr>>();
+    QFuture<FlowFieldPtr> future = promise->future();
+    promise->start();
+
+    if (goals.empty()) {
+        promise->finish();
+        return future;
+    }
+
+    auto remaining = std::make_shared<std::atomic<int>>(static_cast<int>(goals.size()));
+    for (size_t i = 0; i < goals.size(); ++i) {
+        QtConcurrent::run(&m_queryPool, [this, promise, remaining, token, goal = goals[i],
+                                         index = static_cast<int>(i)]() {
+            TRACE_SPAN("query", "flowFieldsAsync");
+
+            auto shouldStop = [&promise, &token]() {
+                return promise->isCanceled() || token.isCancelled();
+            };
+
+            if (!shouldStop()) {
+                FlowFieldPtr field = flowField(goal, shouldStop);
+                if (!shouldStop())
+                    promise->addResult(std::move(field), index);
+            }
+
+            if (--*remaining == 0) {
+                if (shouldStop())
+                    promise->future().cancel();
+                promise->finish();
+            }
+        });
+    }
+    return future;
+}
+
+void PathFinder::setFlowFieldCacheSize(int count) {
+    m_flowFields.setCapacity(count);
+}
+
 void PathFinder::findPath(const QPoint& endPoint, bool isPreview) {
-    auto path = bfs(m_model->startPoint(), endPoint);
+    TRACE_SPAN("query", "findPath");
+
+    auto path = search(m_model->startPoint(), endPoint, []() {
+        return QThread::currentThread()->isInterruptionRequested();
+    });
+
+    TRACE_INSTANT("signal", "pathFound");
 
     if (isPreview) {
         emit pathFound(path, true);
     } else {
-        if (path.empty())
+        if (!path)
             emit pathNotFound();
         else
             emit pathFound(path, false);
@@ -33,74 +453,304 @@ void PathFinder::findPath(const QPoint& endPoint, bool isPreview) {
     }
 }
 
-std::vector<QPoint> PathFinder::bfs(const QPoint &start, const QPoint &end) {
-    if (start == end)
-        return {start};
+std::shared_ptr<const LandmarkTable> PathFinder::landmarks() const {
+    QMutexLocker locker(&m_landmarksMutex);
+    return m_landmarksStale ? nullptr : m_landmarks;
+}
 
-    if (!m_model->isValidPoint(start) || !m_model->isValidPoint(end) ||
-        !m_model->isWalkable(end.x(), end.y()))
-        return {};
+void PathFinder::setLandmarks(std::shared_ptr<const LandmarkTable> table) {
+    QMutexLocker locker(&m_landmarksMutex);
+    m_landmarkToken.cancel();
+    m_landmarks = std::move(table);
+    m_landmarksStale = false;
+}
+
+void PathFinder::setLandmarkCount(int count) {
+    m_landmarkCount = count;
+}
 
+void PathFinder::setConnectivity(Connectivity connectivity) {
+    m_connectivity = connectivity;
+}
+
+void PathFinder::setCostModel(CostModel model) {
+    m_costModel = model;
+}
+
+void PathFinder::onLayoutChanged() {
     int width = m_model->width();
     int height = m_model->height();
+    bool dense = width > 0 && height > 0 &&
+                 static_cast<size_t>(width) * height <= DENSE_MASK_LIMIT_cnt;
+
+    // Маска - раньше ориентиров: сборка маски, успевшая проверить свой
+    // токен, уже поставила пересчет, и его отменит следующий блок
+    CancellationToken token;
+    {
+        QMutexLocker locker(&m_maskMutex);
+        m_maskToken.cancel();
+        m_maskToken = token;
+        m_mask.reset();
+        m_maskPending = dense;
+        m_pendingDeltas.clear();
+    }
+    {
+        QMutexLocker locker(&m_landmarksMutex);
+        m_landmarkToken.cancel();
+        m_landmarks.reset();
+        m_landmarksStale = false;
+    }
 
-    std::queue<QPoint> queue;
-    std::vector<std::vector<bool>> visited(height, std::vector<bool>(width, false));
-    std::vector<std::vector<QPoint>> cameFrom(height,
-                                        std::vector<QPoint>(width, QPoint(-1, -1)));
+    m_flowFields.clear();
 
-    queue.push(start);
-    visited[start.y()][start.x()] = true;
+    if (!dense)
+        return;
 
-    const QPoint directions[] = {
-        QPoint(0, 1),   // вниз
-        QPoint(1, 0),   // вправо
-        QPoint(0, -1),  // вверх
-        QPoint(-1, 0)   // влево
-    };
+    // Снимок собирается в пуле; пока его нет, поиск читает карту через курсор.
+    // Курсор берется здесь - он привязан к только что смененной карте
+    QtConcurrent::run(&m_queryPool, [this, cells = m_model->cursor(), width, height,
+                                     token]() mutable {
+        buildMask(cells, width, height, token);
+    });
+}
 
-    int steps = 0;
+void PathFinder::buildMask(ChunkedGrid::Cursor &cells, int width, int height,
+                           const CancellationToken &token) {
+    TRACE_SPAN("mask", "build");
 
-    while (!queue.empty()) {
-        if (QThread::currentThread()->isInterruptionRequested())
-            return {};
+    auto mask = std::make_shared<PaddedMask>(cells, width, height);
 
-        QPoint current = queue.front();
-        queue.pop();
-        steps++;
+    QMutexLocker locker(&m_maskMutex);
+    if (token.isCancelled())
+        return;
 
-        if (current == end)
-            return reconstructPath(cameFrom, current);
+    // Правки во время сборки: часть из них курсор мог уже увидеть,
+    // повторное наложение в том же порядке дает то же состояние
+    for (const auto &delta : m_pendingDeltas)
+        mask->patch(delta.opened, delta.closed);
+    m_pendingDeltas.clear();
 
-        for (const auto &dir : directions) {
-            QPoint neighbor = current + dir;
-            int nx = neighbor.x();
-            int ny = neighbor.y();
+    m_mask = mask;
+    m_maskPending = false;
 
-            if (nx >= 0 && nx < width && ny >= 0 && ny < height &&
-                m_model->isWalkable(nx, ny) && !visited[ny][nx]) {
+    // Ориентиры считаются по тому же снимку; без него ALT не используется.
+    // Таблицу, подставленную до готовности снимка (например, из сеанса),
+    // заново не считаем, а после открытия клеток - только пересчитываем
+    std::shared_ptr<const LandmarkTable> previous;
+    {
+        QMutexLocker landmarksLocker(&m_landmarksMutex);
+        if (m_landmarks && m_landmarks->width() == width && m_landmarks->height() == height) {
+            if (!m_landmarksStale)
+                return;
+            previous = m_landmarks;
+        }
+    }
+    scheduleLandmarkBuild(std::move(previous), std::move(mask));
+}
+
+void PathFinder::onCellsChanged(const GridDelta &delta) {
+    TRACE_SPAN("model", "PathFinder::onCellsChanged");
+
+    if (delta.opened.empty() && delta.closed.empty())
+        return;
 
-                visited[ny][nx] = true;
-                cameFrom[ny][nx] = current;
-                queue.push(neighbor);
+    {
+        // Под блокировкой маски до конца: сборка маски в пуле не вклинится
+        // между правкой снимка и пересчетом ориентиров
+        QMutexLocker locker(&m_maskMutex);
+
+        if (m_mask) {
+            // Снимок держат запросы или пересчет ориентиров - правим копию
+            if (m_mask.use_count() > 1)
+                m_mask = std::make_shared<PaddedMask>(*m_mask);
+            m_mask->patch(delta.opened, delta.closed);
+        } else if (m_maskPending) {
+            m_pendingDeltas.push_back(delta);
+        }
+
+        // Новые стены только удлиняют расстояния - таблица остается
+        // допустимой. Пересчет один на всю правку, сколько бы клеток в ней
+        // ни открылось
+        if (!delta.opened.empty()) {
+            std::shared_ptr<const LandmarkTable> previous;
+            {
+                QMutexLocker landmarksLocker(&m_landmarksMutex);
+                // Отменяем прошлый пересчет до пометки, иначе он успеет снять ее
+                m_landmarkToken.cancel();
+                previous = m_landmarks;
+                m_landmarksStale = true;
             }
+
+            // Пересчет идет по исправленному снимку, карту заново не читаем.
+            // Снимок еще собирается - ориентиры поставит его сборка
+            if (m_mask)
+                scheduleLandmarkBuild(std::move(previous), m_mask);
         }
     }
-    return {};
+
+    // После маски: поле, построенное до правки, не попадет в кэш
+    m_flowFields.invalidate(delta.region);
+}
+
+void PathFinder::scheduleLandmarkBuild(std::shared_ptr<const LandmarkTable> previous,
+                                       std::shared_ptr<const PaddedMask> mask) {
+    if (static_cast<size_t>(mask->width()) * mask->height() > LANDMARK_LIMIT_cnt)
+        return;
+
+    CancellationToken token;
+    {
+        QMutexLocker locker(&m_landmarksMutex);
+        m_landmarkToken = token;
+    }
+
+    QtConcurrent::run(&m_queryPool, [this, count = m_landmarkCount.load(), token,
+                                     mask = std::move(mask),
+                                     previous = std::move(previous)]() {
+        TRACE_SPAN("landmarks", previous ? "rebuild" : "build");
+
+        std::shared_ptr<const LandmarkTable> table;
+        if (previous)
+            table = LandmarkTable::rebuild(*previous, *mask, token);
+        else
+            table = LandmarkTable::build(*mask, count, token);
+
+        if (!table)
+            return;
+
+        QMutexLocker locker(&m_landmarksMutex);
+        if (token.isCancelled())
+            return;
+        m_landmarks = std::move(table);
+        m_landmarksStale = false;
+    });
+}
+
+std::shared_ptr<const PaddedMask> PathFinder::currentMask(
+    int width, int height, std::shared_ptr<const LandmarkTable> *landmarks) const {
+    QMutexLocker locker(&m_maskMutex);
+    if (!m_mask || m_mask->width() != width || m_mask->height() != height)
+        return nullptr;
+
+    if (landmarks) {
+        // Под m_maskMutex: правка снимка и пометка таблицы устаревшей идут
+        // в одной секции, пара не разойдется
+        QMutexLocker landmarksLocker(&m_landmarksMutex);
+        if (!m_landmarksStale && m_landmarks && !m_landmarks->landmarks().empty() &&
+            m_landmarks->width() == width && m_landmarks->height() == height)
+            *landmarks = m_landmarks;
+    }
+    return m_mask;
 }
 
-std::vector<QPoint> PathFinder::reconstructPath(
-                                    const std::vector<std::vector<QPoint>> &cameFrom,
-                                    const QPoint &current) {
+PathPtr PathFinder::search(const QPoint &start, const QPoint &end,
+                           const StopCondition &shouldStop) {
+    return searchWaypoints(start, end, std::nullopt, shouldStop).cells;
+}
+
+WaypointPath PathFinder::searchWaypoints(const QPoint &start, const QPoint &end,
+                                         std::optional<PathSimplifier::Mode> mode,
+                                         const StopCondition &shouldStop) {
+    WaypointPath result;
+
+    if (start == end) {
+        result.cells = std::make_shared<CompactPath>(start);
+        if (mode)
+            result.waypoints = PathSimplifier::collinear(*result.cells);
+        return result;
+    }
+
+    // Размер и концы - по одному курсору: карта может смениться в потоке
+    // модели посреди запроса, курсор видит ее целиком прежней или новой
+    ChunkedGrid::Cursor cells = m_model->cursor();
+    const int width = cells.width();
+    const int height = cells.height();
+    if (!QRect(0, 0, width, height).contains(start) || !cells.isWalkable(end.x(), end.y()))
+        return result;
+
+    Connectivity connectivity = m_connectivity;
 
-    std::vector<QPoint> path;
-    QPoint currentPoint = current;
+    // Ориентиры - только вместе со снимком: курсор читает карту раньше, чем
+    // правка пометит таблицу устаревшей
+    std::shared_ptr<const LandmarkTable> landmarks;
+    std::shared_ptr<const PaddedMask> mask =
+        currentMask(width, height, connectivity == Connectivity::Four ? &landmarks : nullptr);
 
-    while (currentPoint != QPoint(-1, -1)) {
-        path.push_back(currentPoint);
-        currentPoint = cameFrom[currentPoint.y()][currentPoint.x()];
+    if (mask) {
+        result.cells = searchOn(*mask, start, end, connectivity, m_costModel,
+                                landmarks.get(), shouldStop);
+        if (mode)
+            return PathSimplifier::simplify(std::move(result.cells), *mode, *mask);
+        return result;
     }
 
-    std::reverse(path.begin(), path.end());
-    return path;
+    // Блоки карты подтягиваются по мере обхода, без блокировок на каждую клетку.
+    // Сжатие читает те же закрепленные блоки
+    SearchKernel::CursorStorage storage(std::move(cells), width, height);
+    result.cells = searchOn(storage, start, end, connectivity, m_costModel,
+                            nullptr, shouldStop);
+    if (mode)
+        return PathSimplifier::simplify(std::move(result.cells), *mode, storage);
+    return result;
+}
+
+FlowFieldPtr PathFinder::flowField(const QPoint &goal, const StopCondition &shouldStop) {
+    ChunkedGrid::Cursor cells = m_model->cursor();
+    if (!cells.isWalkable(goal.x(), goal.y()))
+        return nullptr;
+
+    Connectivity connectivity = m_connectivity;
+    CostModel costModel = m_costModel;
+    const int variant = static_cast<int>(connectivity) * 2 + static_cast<int>(costModel);
+
+    if (FlowFieldPtr cached = m_flowFields.find(goal, variant))
+        return cached;
+
+    // Поколение - до снимка карты, см. FlowFieldCache
+    const quint64 generation = m_flowFields.generation();
+
+    const int width = cells.width();
+    const int height = cells.height();
+
+    std::shared_ptr<const PaddedMask> mask = currentMask(width, height);
+
+    FlowFieldPtr field;
+    if (mask) {
+        field = floodOn(*mask, goal, connectivity, costModel, shouldStop);
+    } else {
+        SearchKernel::CursorStorage storage(std::move(cells), width, height);
+        field = floodOn(storage, goal, connectivity, costModel, shouldStop);
+    }
+
+    m_flowFields.insert(field, variant, generation);
+    return field;
+}
+
+std::vector<PathPtr> PathFinder::searchNearest(const QPoint &start, std::vector<QPoint> goals,
+                                               int count, const StopCondition &shouldStop) {
+    ChunkedGrid::Cursor cells = m_model->cursor();
+    if (count <= 0 || !cells.isWalkable(start.x(), start.y()))
+        return {};
+
+    const int width = cells.width();
+    const int height = cells.height();
+    const int stride = width + 2;
+
+    std::vector<int> targets;
+    targets.reserve(goals.size());
+    for (const auto &goal : goals) {
+        if (cells.isWalkable(goal.x(), goal.y()))
+            targets.push_back(SearchKernel::paddedIndex(goal.x(), goal.y(), stride));
+    }
+    std::sort(targets.begin(), targets.end());
+    targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+    if (targets.empty())
+        return {};
+
+    count = std::min(count, static_cast<int>(targets.size()));
+
+    if (std::shared_ptr<const PaddedMask> mask = currentMask(width, height))
+        return nearestOn(*mask, start, targets, count, m_connectivity, m_costModel, shouldStop);
+
+    SearchKernel::CursorStorage storage(std::move(cells), width, height);
+    return nearestOn(storage, start, targets, count, m_connectivity, m_costModel, shouldStop);
 }
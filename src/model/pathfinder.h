@@ -1,36 +1,174 @@
 #ifndef PATHFINDER_H
 #define PATHFINDER_H
 
+#include <QFuture>
+#include <QMutex>
 #include <QObject>
 #include <QPoint>
 #include <QThread>
+#include <QThreadPool>
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <vector>
 
+#include "cancellationtoken.h"
+#include "compactpath.h"
+#include "flowfield.h"
 #include "gridmodel.h"
+#include "landmarktable.h"
+#include "paddedmask.h"
+#include "pathsimplifier.h"
 
 class PathFinder : public QObject {
     Q_OBJECT
 
+    static constexpr int DEFAULT_LANDMARK_cnt = 8;
+
+    // Карты до этого размера держат плотную копию проходимости для поиска,
+    // большие читаются блоками через курсор
+    static constexpr size_t DENSE_MASK_LIMIT_cnt = size_t(1) << 24;
+    // Таблица ALT занимает 2 байта на клетку на ориентир - на больших картах
+    // поиск идет без нее
+    static constexpr size_t LANDMARK_LIMIT_cnt = size_t(1) << 22;
+
 public:
+    using StopCondition = std::function<bool()>;
+
+    struct PathQuery {
+        QPoint start;
+        QPoint end;
+    };
+
+    enum class Connectivity {
+        Four,
+        Eight
+    };
+
+    // Weighted: диагональный шаг дороже прямого (~sqrt(2)), для 4-связной
+    // сетки совпадает с Unit
+    enum class CostModel {
+        Unit,
+        Weighted
+    };
+
     explicit PathFinder(GridModel *model, QObject *parent = nullptr);
     ~PathFinder();
 
+    // Типизированный асинхронный запрос: выполняется в пуле потоков,
+    // результат привязан к своему QFuture. Можно вызывать из любого потока.
+    // Отмена - через token или QFuture::cancel(); отмененный запрос не дает
+    // результата, продолжения .then() для него не вызываются.
+    QFuture<PathPtr> findPathAsync(const QPoint &start, const QPoint &end,
+                                   const CancellationToken &token = CancellationToken());
+
+    // Пакет запросов одной задачей пула: результат i-го запроса - i-й
+    // результат QFuture (resultAt/resultReadyAt), по мере готовности.
+    // Ненайденный путь - пустой PathPtr. После отмены оставшиеся запросы
+    // пакета не выполняются
+    QFuture<PathPtr> findPathsAsync(std::vector<PathQuery> queries,
+                                    const CancellationToken &token = CancellationToken());
+
+    // Пакет запросов путей вместе с опорными точками (PathSimplifier), как
+    // findPathsAsync. Сжатие идет в той же задаче пула, что и поиск, и по тому
+    // же снимку карты. Путь не найден - пустой cells
+    QFuture<WaypointPath> findWaypointsAsync(std::vector<PathQuery> queries,
+                                             PathSimplifier::Mode mode,
+                                             const CancellationToken &token = CancellationToken());
+
+    // Ближайшие из целей goals: один поиск от start, который идет до count-й
+    // достигнутой цели, вместо запроса на каждую цель. Результаты - пути
+    // в порядке возрастания стоимости (цель - end() пути), их меньше count,
+    // если остальные цели недостижимы. Ориентиры ALT здесь не используются
+    QFuture<PathPtr> findNearestAsync(const QPoint &start, std::vector<QPoint> goals,
+                                      int count = 1,
+                                      const CancellationToken &token = CancellationToken());
+
+    // Поле направлений к goal для множества агентов с одной целью, в текущем
+    // режиме связности и стоимости. Поля кэшируются по целям (LRU), правка
+    // клеток сбрасывает только поля, которые она затрагивает. Недопустимая
+    // цель или отмена - пустой FlowFieldPtr
+    QFuture<FlowFieldPtr> flowFieldAsync(const QPoint &goal,
+                                         const CancellationToken &token = CancellationToken());
+    // Поля для нескольких целей параллельно, i-й результат - поле goals[i].
+    // После отмены поля, построение которых не началось, не строятся
+    QFuture<FlowFieldPtr> flowFieldsAsync(std::vector<QPoint> goals,
+                                          const CancellationToken &token = CancellationToken());
+    void setFlowFieldCacheSize(int count);
+
+    // Таблица ориентиров ALT для текущей карты. Строится в фоне при смене
+    // карты; пока ее нет или она устарела, поиск идет обычным BFS, а здесь
+    // возвращается пустой указатель
+    std::shared_ptr<const LandmarkTable> landmarks() const;
+    // Установка готовой таблицы, например сохраненной вместе с картой
+    void setLandmarks(std::shared_ptr<const LandmarkTable> table);
+    void setLandmarkCount(int count);
+
+    // Действуют со следующего запроса. Ориентиры ALT посчитаны для прямых
+    // шагов, поэтому в 8-связной сетке не используются
+    void setConnectivity(Connectivity connectivity);
+    void setCostModel(CostModel model);
+
 public slots:
     void findPath(const QPoint& endPoint, bool isPreview = false);
 
 signals:
-    void pathFound(const std::vector<QPoint> &path, bool isPreview);
+    void pathFound(PathPtr path, bool isPreview);
     void calculationFinished();
     void pathNotFound();
 
 private:
     GridModel *m_model;
     QThread m_workerThread;
+    QThreadPool m_queryPool;
+
+    mutable QMutex m_landmarksMutex;
+    std::shared_ptr<const LandmarkTable> m_landmarks;
+    // Открыта клетка: расстояния могли уменьшиться, оценка недопустима
+    bool m_landmarksStale = false;
+    std::atomic<int> m_landmarkCount { DEFAULT_LANDMARK_cnt };
+    // Токен текущего фонового пересчета
+    CancellationToken m_landmarkToken;
+
+    // Снимок проходимости с рамкой; нет - поиск читает карту через курсор.
+    // Наружу отдается как const, правится на месте, пока его никто не держит.
+    // Строится в пуле после смены карты; правки, пришедшие до готовности,
+    // копятся в m_pendingDeltas и накладываются на готовый снимок.
+    // Блокировки берутся в порядке m_maskMutex, затем m_landmarksMutex
+    mutable QMutex m_maskMutex;
+    std::shared_ptr<PaddedMask> m_mask;
+    CancellationToken m_maskToken;
+    bool m_maskPending = false;
+    std::vector<GridDelta> m_pendingDeltas;
+
+    std::atomic<Connectivity> m_connectivity { Connectivity::Four };
+    std::atomic<CostModel> m_costModel { CostModel::Unit };
+
+    FlowFieldCache m_flowFields;
+
+    void onLayoutChanged();
+    void onCellsChanged(const GridDelta &delta);
+    void buildMask(ChunkedGrid::Cursor &cells, int width, int height,
+                   const CancellationToken &token);
+    // Вызывается под m_maskMutex
+    void scheduleLandmarkBuild(std::shared_ptr<const LandmarkTable> previous,
+                               std::shared_ptr<const PaddedMask> mask);
+
+    // Снимок карты и, если задан landmarks, таблица ориентиров из того же
+    // состояния (блокировки в порядке m_maskMutex, m_landmarksMutex)
+    std::shared_ptr<const PaddedMask> currentMask(
+        int width, int height, std::shared_ptr<const LandmarkTable> *landmarks = nullptr) const;
 
-    std::vector<QPoint> bfs(const QPoint &start, const QPoint &end);
-    std::vector<QPoint> reconstructPath(const std::vector<std::vector<QPoint>> &cameFrom,
-                                        const QPoint &current);
+    PathPtr search(const QPoint &start, const QPoint &end, const StopCondition &shouldStop);
+    // Поиск и, если задан mode, сжатие пути по снимку, на котором он найден
+    WaypointPath searchWaypoints(const QPoint &start, const QPoint &end,
+                                 std::optional<PathSimplifier::Mode> mode,
+                                 const StopCondition &shouldStop);
+    std::vector<PathPtr> searchNearest(const QPoint &start, std::vector<QPoint> goals, int count,
+                                       const StopCondition &shouldStop);
+    FlowFieldPtr flowField(const QPoint &goal, const StopCondition &shouldStop);
 };
 
 #endif // PATHFINDER_H
@@ -0,0 +1,29 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "pathsimplifier.h"
+
+std::vector<QPoint> PathSimplifier::collinear(const CompactPath &path) {
+    std::vector<QPoint> corners { path.start() };
+
+    QPoint position = path.start();
+    uint8_t previous = Direction::NONE;
+
+    for (uint32_t run : path.runs()) {
+        uint8_t dir = CompactPath::runDirection(run);
+        uint32_t length = CompactPath::runLength(run);
+
+        // Длинная серия могла быть разбита на несколько с тем же направлением
+        if (dir == previous && corners.size() > 1)
+            corners.pop_back();
+
+        position += QPoint(Direction::DX[dir], Direction::DY[dir]) * static_cast<int>(length);
+        corners.push_back(position);
+        previous = dir;
+    }
+    return corners;
+}
+
+bool PathSimplifier::inSightRange(const QPoint &a, const QPoint &b) {
+    return std::max(std::abs(a.x() - b.x()), std::abs(a.y() - b.y())) <= MAX_SIGHT_cnt;
+}
@@ -0,0 +1,144 @@
+#ifndef PATHSIMPLIFIER_H
+#define PATHSIMPLIFIER_H
+
+#include <QMetaType>
+#include <QPoint>
+
+#include <cstdlib>
+#include <vector>
+
+#include "compactpath.h"
+#include "searchkernel.h"
+#include "tracing.h"
+
+// Путь по клеткам и его опорные точки: отрисовке и клиентам хватает точек,
+// их число зависит от поворотов, а не от длины пути
+struct WaypointPath {
+    PathPtr cells;
+    std::vector<QPoint> waypoints;
+};
+
+Q_DECLARE_METATYPE(WaypointPath)
+
+// Сжатие пути в опорные точки.
+//
+// Collinear - углы пути: прямые участки сворачиваются в концы, точки лежат
+// на клетках пути, и переход по прямым между ними повторяет путь в точности.
+//
+// LineOfSight - "натягивание нити": опорная точка пропускается, если отрезок
+// от предыдущей точки до следующей идет только по проходимым клеткам (угол
+// стены отрезок не срезает). Точки остаются на клетках пути, но отрезки
+// между ними - в любом направлении, не только по сетке.
+class PathSimplifier final {
+
+    // Длина проверяемого отрезка ограничена: на ступенчатом пути проверка
+    // каждой пары углов иначе стоит квадрат длины пути
+    static constexpr int MAX_SIGHT_cnt = 256;
+
+public:
+    enum class Mode {
+        Collinear,
+        LineOfSight
+    };
+
+    static std::vector<QPoint> collinear(const CompactPath &path);
+
+    // Видимость проверяется по хранилищу поиска (см. searchkernel.h) -
+    // по тому же снимку карты, по которому путь найден
+    template <typename Storage>
+    static std::vector<QPoint> lineOfSight(const CompactPath &path, Storage &storage);
+
+    // Все клетки, которые задевает отрезок между центрами клеток, проходимы;
+    // через общий угол двух клеток отрезок проходит, только если обе проходимы
+    template <typename Storage>
+    static bool isVisible(Storage &storage, const QPoint &from, const QPoint &to);
+
+    template <typename Storage>
+    static WaypointPath simplify(PathPtr path, Mode mode, Storage &storage);
+
+private:
+    static bool inSightRange(const QPoint &a, const QPoint &b);
+};
+
+template <typename Storage>
+std::vector<QPoint> PathSimplifier::lineOfSight(const CompactPath &path, Storage &storage) {
+    TRACE_SPAN("simplify", "lineOfSight");
+
+    const std::vector<QPoint> corners = collinear(path);
+    if (corners.size() <= 2)
+        return corners;
+
+    // Жадно: от последней опорной точки тянемся к самому дальнему видимому углу
+    std::vector<QPoint> waypoints { corners.front() };
+    size_t anchor = 0;
+
+    for (size_t next = 2; next < corners.size(); ++next) {
+        const QPoint &from = corners[anchor];
+        if (inSightRange(from, corners[next]) && isVisible(storage, from, corners[next]))
+            continue;
+
+        anchor = next - 1;
+        waypoints.push_back(corners[anchor]);
+    }
+
+    waypoints.push_back(corners.back());
+    return waypoints;
+}
+
+template <typename Storage>
+bool PathSimplifier::isVisible(Storage &storage, const QPoint &from, const QPoint &to) {
+    const int stride = storage.stride();
+    auto walkable = [&storage, stride](int x, int y) {
+        return storage.isWalkable(SearchKernel::paddedIndex(x, y, stride), x, y);
+    };
+
+    int dx = std::abs(to.x() - from.x());
+    int dy = std::abs(to.y() - from.y());
+    const int stepX = to.x() > from.x() ? 1 : -1;
+    const int stepY = to.y() > from.y() ? 1 : -1;
+
+    int x = from.x();
+    int y = from.y();
+
+    // Обход всех клеток под отрезком: error сравнивает, какую границу клетки
+    // отрезок пересечет раньше - вертикальную или горизонтальную
+    int error = dx - dy;
+    dx *= 2;
+    dy *= 2;
+
+    for (int remaining = (dx + dy) / 2; ; --remaining) {
+        if (!walkable(x, y))
+            return false;
+        if (remaining <= 0)
+            return true;
+
+        if (error > 0) {
+            x += stepX;
+            error -= dy;
+        } else if (error < 0) {
+            y += stepY;
+            error += dx;
+        } else {
+            // Точно через угол: обе соседние клетки, как у диагонального шага
+            if (!walkable(x + stepX, y) || !walkable(x, y + stepY))
+                return false;
+            x += stepX;
+            y += stepY;
+            error += dx - dy;
+            --remaining;
+        }
+    }
+}
+
+template <typename Storage>
+WaypointPath PathSimplifier::simplify(PathPtr path, Mode mode, Storage &storage) {
+    WaypointPath result;
+    if (!path)
+        return result;
+
+    result.waypoints = mode == Mode::LineOfSight ? lineOfSight(*path, storage) : collinear(*path);
+    result.cells = std::move(path);
+    return result;
+}
+
+#endif // PATHSIMPLIFIER_H
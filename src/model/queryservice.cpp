@@ -0,0 +1,458 @@
+#include <QDebug>
+#include <QFutureWatcher>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QtEndian>
+
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+
+#include "queryservice.h"
+#include "tracing.h"
+
+namespace {
+
+constexpr int LENGTH_bytes = 4;
+// id + тип
+constexpr quint32 HEADER_bytes = 5;
+constexpr quint32 FIND_PATH_bytes = HEADER_bytes + 4 * 2;
+// Старт и число путей, дальше цели по 4 байта
+constexpr quint32 FIND_NEAREST_bytes = HEADER_bytes + 2 * 2 + 1;
+// Буфер чтения сокета ограничен: пока запросы не разобраны, клиента
+// притормаживает сама ОС
+constexpr qint64 READ_BUFFER_bytes = 64 << 10;
+
+template <typename T>
+void append(QByteArray &out, T value) {
+    char raw[sizeof(T)];
+    qToLittleEndian<T>(value, raw);
+    out.append(raw, sizeof(T));
+}
+
+} // namespace
+
+QueryService::QueryService(const GridModel *model, PathFinder *pathFinder, QObject *parent)
+    : QObject(parent), m_model(model), m_pathFinder(pathFinder),
+      m_server(new QLocalServer(this)) {
+
+    connect(m_server, &QLocalServer::newConnection, this, &QueryService::onNewConnection);
+}
+
+QueryService::~QueryService() {
+    // Пакеты в пуле дорабатывают вхолостую, ответы уже некому слать
+    for (auto &entry : m_connections)
+        entry.second->token.cancel();
+}
+
+bool QueryService::listen(const QString &name) {
+    QLocalServer::removeServer(name);
+
+    if (!m_server->listen(name)) {
+        qWarning() << "QueryService: не удалось открыть" << name << m_server->errorString();
+        return false;
+    }
+    return true;
+}
+
+QString QueryService::fullServerName() const {
+    return m_server->fullServerName();
+}
+
+void QueryService::onNewConnection() {
+    while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+        auto connection = std::make_unique<Connection>();
+        connection->id = m_nextConnectionId++;
+        connection->socket = socket;
+        socket->setReadBufferSize(READ_BUFFER_bytes);
+
+        const quint64 id = connection->id;
+        m_connections.emplace(id, std::move(connection));
+
+        auto resume = [this, id]() {
+            if (Connection *current = this->connection(id))
+                processInput(*current);
+        };
+        connect(socket, &QLocalSocket::readyRead, this, resume);
+        // Клиент дочитал ответы - можно принимать новые запросы
+        connect(socket, &QLocalSocket::bytesWritten, this, resume);
+        connect(socket, &QLocalSocket::disconnected, this, [this, id]() {
+            closeConnection(id);
+        });
+
+        // Данные могли прийти вместе с подключением
+        resume();
+    }
+}
+
+QueryService::Connection *QueryService::connection(quint64 id) const {
+    auto it = m_connections.find(id);
+    return it != m_connections.end() ? it->second.get() : nullptr;
+}
+
+void QueryService::closeConnection(quint64 id) {
+    auto it = m_connections.find(id);
+    if (it == m_connections.end())
+        return;
+
+    // Незапущенные пакеты соединения не выполняются
+    it->second->token.cancel();
+
+    QLocalSocket *socket = it->second->socket;
+    m_connections.erase(it);
+
+    socket->disconnect(this);
+    socket->abort();
+    socket->deleteLater();
+}
+
+void QueryService::processInput(Connection &connection) {
+    TRACE_SPAN("service", "processInput");
+
+    auto saturated = [&connection]() {
+        return connection.inFlight >= MAX_IN_FLIGHT_cnt ||
+               connection.socket->bytesToWrite() >= MAX_PENDING_WRITE_bytes;
+    };
+
+    if (!saturated())
+        connection.input.append(connection.socket->readAll());
+
+    std::vector<quint32> pathIds;
+    std::vector<PathFinder::PathQuery> pathQueries;
+    std::vector<quint32> waypointIds;
+    std::vector<PathFinder::PathQuery> waypointQueries;
+
+    auto dispatchPaths = [&]() {
+        if (pathQueries.empty())
+            return;
+        dispatch(connection, std::exchange(pathIds, {}),
+                 m_pathFinder->findPathsAsync(std::exchange(pathQueries, {}), connection.token));
+    };
+    auto dispatchWaypoints = [&]() {
+        if (waypointQueries.empty())
+            return;
+        dispatch(connection, std::exchange(waypointIds, {}),
+                 m_pathFinder->findWaypointsAsync(std::exchange(waypointQueries, {}),
+                                                  PathSimplifier::Mode::LineOfSight,
+                                                  connection.token));
+    };
+
+    std::vector<QPoint> flowGoals;
+    std::vector<std::vector<FlowStep>> flowSteps;
+    int flowStepCount = 0;
+
+    auto dispatchFlow = [&]() {
+        if (flowGoals.empty())
+            return;
+        dispatchFlowSteps(connection, std::exchange(flowGoals, {}),
+                                std::exchange(flowSteps, {}));
+        flowStepCount = 0;
+    };
+
+    const char *data = connection.input.constData();
+    const qsizetype size = connection.input.size();
+    qsizetype offset = 0;
+    bool broken = false;
+
+    while (!saturated() && size - offset >= LENGTH_bytes) {
+        const quint32 length = qFromLittleEndian<quint32>(data + offset);
+        if (length < HEADER_bytes || length > MAX_FRAME_bytes) {
+            qWarning() << "QueryService: неверная длина кадра" << length;
+            broken = true;
+            break;
+        }
+        if (size - offset - LENGTH_bytes < length)
+            break;
+
+        const char *body = data + offset + LENGTH_bytes;
+        offset += LENGTH_bytes + length;
+
+        const quint32 requestId = qFromLittleEndian<quint32>(body);
+        const auto type = static_cast<RequestType>(static_cast<quint8>(body[4]));
+
+        switch (type) {
+        case RequestType::FindPath:
+        case RequestType::FindWaypoints: {
+            if (length != FIND_PATH_bytes) {
+                writeStatus(connection, requestId, Status::BadRequest);
+                break;
+            }
+            const bool waypoints = type == RequestType::FindWaypoints;
+            auto &ids = waypoints ? waypointIds : pathIds;
+            auto &queries = waypoints ? waypointQueries : pathQueries;
+
+            const char *points = body + HEADER_bytes;
+            ids.push_back(requestId);
+            queries.push_back({ QPoint(qFromLittleEndian<quint16>(points),
+                                       qFromLittleEndian<quint16>(points + 2)),
+                                QPoint(qFromLittleEndian<quint16>(points + 4),
+                                       qFromLittleEndian<quint16>(points + 6)) });
+            ++connection.inFlight;
+
+            if (static_cast<int>(queries.size()) == BATCH_cnt) {
+                if (waypoints)
+                    dispatchWaypoints();
+                else
+                    dispatchPaths();
+            }
+            break;
+        }
+        case RequestType::FlowStep: {
+            if (length != FIND_PATH_bytes) {
+                writeStatus(connection, requestId, Status::BadRequest);
+                break;
+            }
+            const char *points = body + HEADER_bytes;
+            const QPoint position(qFromLittleEndian<quint16>(points),
+                                  qFromLittleEndian<quint16>(points + 2));
+            const QPoint goal(qFromLittleEndian<quint16>(points + 4),
+                              qFromLittleEndian<quint16>(points + 6));
+
+            // Целей в пакете не больше BATCH_cnt, линейного поиска хватает
+            auto it = std::find(flowGoals.begin(), flowGoals.end(), goal);
+            if (it == flowGoals.end()) {
+                flowGoals.push_back(goal);
+                flowSteps.emplace_back();
+                it = flowGoals.end() - 1;
+            }
+            flowSteps[it - flowGoals.begin()].push_back({ requestId, position });
+            ++connection.inFlight;
+
+            if (++flowStepCount == BATCH_cnt)
+                dispatchFlow();
+            break;
+        }
+        case RequestType::FindNearest: {
+            const quint32 goalCount = length >= FIND_NEAREST_bytes
+                                          ? (length - FIND_NEAREST_bytes) / 4
+                                          : 0;
+            if (length < FIND_NEAREST_bytes || (length - FIND_NEAREST_bytes) % 4 != 0 ||
+                goalCount == 0 || goalCount > static_cast<quint32>(MAX_NEAREST_GOALS_cnt)) {
+                writeStatus(connection, requestId, Status::BadRequest);
+                break;
+            }
+            const char *fields = body + HEADER_bytes;
+            const QPoint start(qFromLittleEndian<quint16>(fields),
+                               qFromLittleEndian<quint16>(fields + 2));
+            const int count = static_cast<quint8>(fields[4]);
+
+            std::vector<QPoint> goals;
+            goals.reserve(goalCount);
+            for (quint32 i = 0; i < goalCount; ++i) {
+                const char *goal = fields + 5 + i * 4;
+                goals.emplace_back(qFromLittleEndian<quint16>(goal),
+                                   qFromLittleEndian<quint16>(goal + 2));
+            }
+
+            ++connection.inFlight;
+            dispatchNearest(connection, requestId, start, std::move(goals), count);
+            break;
+        }
+        case RequestType::MapInfo:
+            writeMapInfo(connection, requestId);
+            break;
+        default:
+            writeStatus(connection, requestId, Status::BadRequest);
+            break;
+        }
+    }
+
+    dispatchPaths();
+    dispatchWaypoints();
+    dispatchFlow();
+
+    if (broken) {
+        closeConnection(connection.id);
+        return;
+    }
+
+    connection.input.remove(0, offset);
+}
+
+template <typename Result>
+void QueryService::dispatch(Connection &connection, std::vector<quint32> requestIds,
+                            QFuture<Result> future) {
+    auto *watcher = new QFutureWatcher<Result>(this);
+    auto batch = std::make_shared<const std::vector<quint32>>(std::move(requestIds));
+    const quint64 connectionId = connection.id;
+
+    // Ответ уходит, как только готов его путь, не дожидаясь всего пакета
+    connect(watcher, &QFutureWatcherBase::resultReadyAt, this,
+            [this, watcher, batch, connectionId](int index) {
+        Connection *current = this->connection(connectionId);
+        if (!current)
+            return;
+
+        if constexpr (std::is_same_v<Result, WaypointPath>)
+            writeWaypoints(*current, (*batch)[index], watcher->resultAt(index));
+        else
+            writePath(*current, (*batch)[index], watcher->resultAt(index));
+        --current->inFlight;
+    });
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, connectionId]() {
+        watcher->deleteLater();
+        if (Connection *current = this->connection(connectionId))
+            processInput(*current);
+    });
+
+    watcher->setFuture(std::move(future));
+}
+
+void QueryService::dispatchFlowSteps(Connection &connection, std::vector<QPoint> goals,
+                                     std::vector<std::vector<FlowStep>> steps) {
+    auto *watcher = new QFutureWatcher<FlowFieldPtr>(this);
+    auto batch = std::make_shared<const std::vector<std::vector<FlowStep>>>(std::move(steps));
+    const quint64 connectionId = connection.id;
+
+    // Поле готово - отвечаем всем агентам с этой целью
+    connect(watcher, &QFutureWatcherBase::resultReadyAt, this,
+            [this, watcher, batch, connectionId](int index) {
+        Connection *current = this->connection(connectionId);
+        if (!current)
+            return;
+
+        const FlowFieldPtr field = watcher->resultAt(index);
+        for (const FlowStep &step : (*batch)[index]) {
+            writeFlowStep(*current, step.id, field, step.position);
+            --current->inFlight;
+        }
+    });
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, connectionId]() {
+        watcher->deleteLater();
+        if (Connection *current = this->connection(connectionId))
+            processInput(*current);
+    });
+
+    watcher->setFuture(m_pathFinder->flowFieldsAsync(std::move(goals), connection.token));
+}
+
+void QueryService::dispatchNearest(Connection &connection, quint32 requestId,
+                                   const QPoint &start, std::vector<QPoint> goals, int count) {
+    auto *watcher = new QFutureWatcher<PathPtr>(this);
+    const quint64 connectionId = connection.id;
+
+    // Пути приходят по одному, но ответ - один кадр на все
+    connect(watcher, &QFutureWatcherBase::finished, this,
+            [this, watcher, connectionId, requestId]() {
+        watcher->deleteLater();
+
+        Connection *current = this->connection(connectionId);
+        if (!current || watcher->isCanceled())
+            return;
+
+        writeNearest(*current, requestId, watcher->future().results());
+        --current->inFlight;
+        processInput(*current);
+    });
+
+    watcher->setFuture(m_pathFinder->findNearestAsync(start, std::move(goals), count,
+                                                      connection.token));
+}
+
+void QueryService::writeFrame(Connection &connection, const QByteArray &body) {
+    QByteArray frame;
+    frame.reserve(LENGTH_bytes + body.size());
+    append<quint32>(frame, static_cast<quint32>(body.size()));
+    frame.append(body);
+    connection.socket->write(frame);
+}
+
+void QueryService::writeStatus(Connection &connection, quint32 requestId, Status status) {
+    QByteArray body;
+    append<quint32>(body, requestId);
+    append<quint8>(body, static_cast<quint8>(status));
+    writeFrame(connection, body);
+}
+
+void QueryService::writePath(Connection &connection, quint32 requestId, const PathPtr &path) {
+    if (!path) {
+        writeStatus(connection, requestId, Status::NotFound);
+        return;
+    }
+
+    const std::vector<uint32_t> &runs = path->runs();
+
+    QByteArray body;
+    body.reserve(HEADER_bytes + 8 + static_cast<qsizetype>(runs.size()) * 4);
+    append<quint32>(body, requestId);
+    append<quint8>(body, static_cast<quint8>(Status::Ok));
+    append<quint16>(body, static_cast<quint16>(path->start().x()));
+    append<quint16>(body, static_cast<quint16>(path->start().y()));
+    append<quint32>(body, static_cast<quint32>(runs.size()));
+    for (uint32_t run : runs)
+        append<quint32>(body, run);
+
+    writeFrame(connection, body);
+}
+
+void QueryService::writeWaypoints(Connection &connection, quint32 requestId,
+                                  const WaypointPath &path) {
+    if (!path.cells) {
+        writeStatus(connection, requestId, Status::NotFound);
+        return;
+    }
+
+    const std::vector<QPoint> &waypoints = path.waypoints;
+
+    QByteArray body;
+    body.reserve(HEADER_bytes + 4 + static_cast<qsizetype>(waypoints.size()) * 4);
+    append<quint32>(body, requestId);
+    append<quint8>(body, static_cast<quint8>(Status::Ok));
+    append<quint32>(body, static_cast<quint32>(waypoints.size()));
+    for (const QPoint &point : waypoints) {
+        append<quint16>(body, static_cast<quint16>(point.x()));
+        append<quint16>(body, static_cast<quint16>(point.y()));
+    }
+
+    writeFrame(connection, body);
+}
+
+void QueryService::writeFlowStep(Connection &connection, quint32 requestId,
+                                 const FlowFieldPtr &field, const QPoint &position) {
+    if (!field || position.x() >= field->width() || position.y() >= field->height() ||
+        !field->isReachable(position)) {
+        writeStatus(connection, requestId, Status::NotFound);
+        return;
+    }
+
+    const QPoint next = field->nextStep(position);
+
+    QByteArray body;
+    append<quint32>(body, requestId);
+    append<quint8>(body, static_cast<quint8>(Status::Ok));
+    append<quint16>(body, static_cast<quint16>(next.x()));
+    append<quint16>(body, static_cast<quint16>(next.y()));
+    writeFrame(connection, body);
+}
+
+void QueryService::writeNearest(Connection &connection, quint32 requestId,
+                                const QList<PathPtr> &paths) {
+    if (paths.empty()) {
+        writeStatus(connection, requestId, Status::NotFound);
+        return;
+    }
+
+    QByteArray body;
+    append<quint32>(body, requestId);
+    append<quint8>(body, static_cast<quint8>(Status::Ok));
+    append<quint8>(body, static_cast<quint8>(paths.size()));
+    for (const PathPtr &path : paths) {
+        const QPoint goal = path->end();
+        append<quint16>(body, static_cast<quint16>(goal.x()));
+        append<quint16>(body, static_cast<quint16>(goal.y()));
+        append<quint32>(body, static_cast<quint32>(path->runs().size()));
+        for (uint32_t run : path->runs())
+            append<quint32>(body, run);
+    }
+    writeFrame(connection, body);
+}
+
+void QueryService::writeMapInfo(Connection &connection, quint32 requestId) {
+    QByteArray body;
+    append<quint32>(body, requestId);
+    append<quint8>(body, static_cast<quint8>(Status::Ok));
+    append<quint32>(body, static_cast<quint32>(m_model->width()));
+    append<quint32>(body, static_cast<quint32>(m_model->height()));
+    append<quint64>(body, m_model->version());
+    writeFrame(connection, body);
+}
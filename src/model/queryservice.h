@@ -0,0 +1,133 @@
+#ifndef QUERYSERVICE_H
+#define QUERYSERVICE_H
+
+#include <QList>
+#include <QObject>
+#include <QString>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "cancellationtoken.h"
+#include "gridmodel.h"
+#include "pathfinder.h"
+
+class QLocalServer;
+class QLocalSocket;
+
+// Служба запросов путей для других процессов через QLocalServer (сокет
+// домена Unix / именованный канал). Карта загружена один раз и общая для
+// всех клиентов, только на чтение.
+//
+// Протокол двоичный, little-endian. Кадр: uint32 длина тела, затем тело.
+//   Запрос:  uint32 id, uint8 тип
+//            FindPath: uint16 x1, y1, x2, y2
+//            FindWaypoints: как FindPath
+//            MapInfo:  -
+//            FlowStep: uint16 x, y агента, x, y цели
+//            FindNearest: uint16 x, y старта, uint8 число путей,
+//                         цели uint16 x, y (не больше MAX_NEAREST_GOALS_cnt)
+//   Ответ:   uint32 id, uint8 статус
+//            FindPath + Ok: uint16 x, y старта, uint32 число серий,
+//                           серии uint32 (CompactPath::encodeRun)
+//            FindWaypoints + Ok: uint32 число точек, точки uint16 x, y
+//                           (PathSimplifier::LineOfSight)
+//            MapInfo + Ok:  uint32 ширина, высота, uint64 версия карты
+//            FlowStep + Ok: uint16 x, y следующей клетки агента к цели
+//                           (поле направлений, общее для агентов с этой целью)
+//            FindNearest + Ok: uint8 число путей, пути к ближайшим целям по
+//                           возрастанию стоимости: uint16 x, y цели, uint32
+//                           число серий, серии от старта запроса
+//
+// Клиент может слать запросы, не дожидаясь ответов; ответы приходят по мере
+// готовности и сопоставляются по id. Запросы, прочитанные за раз, уходят
+// в пул пакетами по типу (PathFinder::findPathsAsync, findWaypointsAsync),
+// а не по задаче на запрос. Шаги FlowStep пакета группируются по целям:
+// поле на цель строится один раз (flowFieldsAsync) и берется из кэша.
+// FindNearest - отдельная задача пула: один поиск на все цели запроса.
+class QueryService final : public QObject {
+    Q_OBJECT
+
+    // Запросов в одной задаче пула
+    static constexpr int BATCH_cnt = 64;
+    // Больше запросов в работе у соединения - чтение приостанавливается
+    static constexpr int MAX_IN_FLIGHT_cnt = 1024;
+    // Клиент не читает ответы - тоже
+    static constexpr qint64 MAX_PENDING_WRITE_bytes = 4 << 20;
+    // Целей в одном FindNearest
+    static constexpr int MAX_NEAREST_GOALS_cnt = 64;
+    // Запросы короткие, длинный кадр - мусор в канале
+    static constexpr quint32 MAX_FRAME_bytes = 512;
+
+public:
+    enum class RequestType : quint8 {
+        FindPath = 1,
+        MapInfo = 2,
+        FindWaypoints = 3,
+        FlowStep = 4,
+        FindNearest = 5
+    };
+
+    enum class Status : quint8 {
+        Ok = 0,
+        NotFound = 1,
+        BadRequest = 2
+    };
+
+    QueryService(const GridModel *model, PathFinder *pathFinder, QObject *parent = nullptr);
+    ~QueryService() override;
+
+    // Старый сокет с тем же именем (после падения) удаляется
+    bool listen(const QString &name);
+    QString fullServerName() const;
+
+private slots:
+    void onNewConnection();
+
+private:
+    struct FlowStep {
+        quint32 id;
+        QPoint position;
+    };
+
+    struct Connection {
+        quint64 id = 0;
+        QLocalSocket *socket = nullptr;
+        QByteArray input;
+        int inFlight = 0;
+        CancellationToken token;
+    };
+
+    const GridModel *m_model;
+    PathFinder *m_pathFinder;
+    QLocalServer *m_server;
+
+    quint64 m_nextConnectionId = 1;
+    std::unordered_map<quint64, std::unique_ptr<Connection>> m_connections;
+
+    Connection *connection(quint64 id) const;
+    void closeConnection(quint64 id);
+
+    void processInput(Connection &connection);
+    // Ответ на i-й запрос пакета - i-й результат future
+    template <typename Result>
+    void dispatch(Connection &connection, std::vector<quint32> requestIds,
+                  QFuture<Result> future);
+    // steps[i] ждут поле goals[i]
+    void dispatchFlowSteps(Connection &connection, std::vector<QPoint> goals,
+                           std::vector<std::vector<FlowStep>> steps);
+    void dispatchNearest(Connection &connection, quint32 requestId, const QPoint &start,
+                         std::vector<QPoint> goals, int count);
+
+    void writeFrame(Connection &connection, const QByteArray &body);
+    void writeStatus(Connection &connection, quint32 requestId, Status status);
+    void writePath(Connection &connection, quint32 requestId, const PathPtr &path);
+    void writeWaypoints(Connection &connection, quint32 requestId, const WaypointPath &path);
+    void writeMapInfo(Connection &connection, quint32 requestId);
+    void writeFlowStep(Connection &connection, quint32 requestId, const FlowFieldPtr &field,
+                       const QPoint &position);
+    void writeNearest(Connection &connection, quint32 requestId, const QList<PathPtr> &paths);
+};
+
+#endif // QUERYSERVICE_H
@@ -0,0 +1,11 @@
+#include "reservationtable.h"
+
+void ReservationTable::reset(int cells, int window) {
+    m_cells = cells;
+    m_window = window;
+    m_reserved.clear();
+}
+
+void ReservationTable::clear() {
+    m_reserved.clear();
+}
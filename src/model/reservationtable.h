@@ -0,0 +1,49 @@
+#ifndef RESERVATIONTABLE_H
+#define RESERVATIONTABLE_H
+
+#include <cstddef>
+#include <unordered_set>
+
+// Пространственно-временная таблица резервирования для кооперативного
+// поиска: занятые пары (клетка, момент) окна [0, window] в хэш-множестве.
+// Резервов - по window + 1 на агента, так что память не зависит от размера
+// карты, а очистка не освобождает корзины множества.
+class ReservationTable final {
+
+public:
+    void reset(int cells, int window);
+    void clear();
+
+    int cells() const {
+        return m_cells;
+    }
+
+    int window() const {
+        return m_window;
+    }
+
+    // Моменты за пределами окна не резервируются и считаются свободными
+    void reserve(int index, int time) {
+        if (time < 0 || time > m_window)
+            return;
+        m_reserved.insert(key(index, time));
+    }
+
+    bool isReserved(int index, int time) const {
+        if (time < 0 || time > m_window)
+            return false;
+        return m_reserved.count(key(index, time)) != 0;
+    }
+
+private:
+    int m_cells = 0;
+    int m_window = 0;
+
+    std::unordered_set<size_t> m_reserved;
+
+    size_t key(int index, int time) const {
+        return static_cast<size_t>(time) * m_cells + index;
+    }
+};
+
+#endif // RESERVATIONTABLE_H
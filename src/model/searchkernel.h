@@ -0,0 +1,262 @@
+#ifndef SEARCHKERNEL_H
+#define SEARCHKERNEL_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "chunkedgrid.h"
+#include "direction.h"
+#include "searchworkspace.h"
+
+// Ядро поиска на сетке, специализированное на этапе компиляции: связность,
+// стоимость шага, что записывается в посещенную клетку и способ чтения карты -
+// параметры шаблонов. Во внутреннем цикле нет ветвлений по настройкам,
+// нужный вариант выбирается один раз на запрос.
+//
+// Индексы клеток - в координатах с рамкой в одну клетку:
+// index = (y + 1) * stride + (x + 1), stride = width + 2. Рабочую область
+// готовят под размер с рамкой: prepare(stride, height + 2).
+namespace SearchKernel {
+
+// Как часто поиск проверяет отмену, в извлеченных из очереди клетках
+constexpr size_t STOP_CHECK_INTERVAL_cnt = 256;
+
+struct FourConnected {
+    static constexpr int COUNT = Direction::COUNT;
+};
+
+// Диагональный шаг не срезает угол: обе прямые клетки рядом с ним проходимы
+struct EightConnected {
+    static constexpr int COUNT = Direction::EXTENDED_COUNT;
+};
+
+struct UnitCost {
+    static constexpr uint32_t STRAIGHT = 1;
+    static constexpr uint32_t DIAGONAL = 1;
+};
+
+// Диагональ в целых весах: 7 / 5 = 1.4, близко к sqrt(2)
+struct OctileCost {
+    static constexpr uint32_t STRAIGHT = 5;
+    static constexpr uint32_t DIAGONAL = 7;
+};
+
+// Код направления шага, байт на клетку: путь восстанавливается по DX/DY
+struct DirectionCode {
+    static constexpr bool DIRECTIONS = true;
+};
+
+// Только расстояние от старта, для полей расстояний без путей
+struct DistanceOnly {
+    static constexpr bool DIRECTIONS = false;
+};
+
+// Чтение блочной карты через курсор. Рамку здесь заменяет проверка границ
+// в самом курсоре, поэтому ему нужны координаты соседа
+class CursorStorage final {
+
+public:
+    CursorStorage(ChunkedGrid::Cursor cursor, int width, int height)
+        : m_cursor(std::move(cursor)), m_width(width), m_height(height) {
+    }
+
+    int width() const {
+        return m_width;
+    }
+
+    int height() const {
+        return m_height;
+    }
+
+    int stride() const {
+        return m_width + 2;
+    }
+
+    bool isWalkable(int index, int x, int y) {
+        Q_UNUSED(index);
+        return m_cursor.isWalkable(x, y);
+    }
+
+private:
+    ChunkedGrid::Cursor m_cursor;
+    int m_width;
+    int m_height;
+};
+
+inline int paddedIndex(int x, int y, int stride) {
+    return (y + 1) * stride + x + 1;
+}
+
+// Смещения индексов соседей: DX/DY известны при компиляции,
+// шаг строки - один раз на запрос
+template <typename Connectivity>
+std::array<int, Connectivity::COUNT> neighbourOffsets(int stride) {
+    std::array<int, Connectivity::COUNT> offsets {};
+    for (int dir = 0; dir < Connectivity::COUNT; ++dir)
+        offsets[dir] = Direction::DY[dir] * stride + Direction::DX[dir];
+    return offsets;
+}
+
+template <typename Storage>
+inline bool canStep(Storage &storage, int current, int neighbor, int dir,
+                    int cx, int cy, int stride) {
+    if (!storage.isWalkable(neighbor, cx + Direction::DX[dir], cy + Direction::DY[dir]))
+        return false;
+    if (!Direction::isDiagonal(dir))
+        return true;
+
+    return storage.isWalkable(current + Direction::DX[dir], cx + Direction::DX[dir], cy) &&
+           storage.isWalkable(current + Direction::DY[dir] * stride, cx, cy + Direction::DY[dir]);
+}
+
+// Поиск в ширину для единичной стоимости шага. reachedGoal(index) вызывается
+// для каждой найденной клетки в порядке расстояния от старта, true - поиск
+// закончен. Возвращает true, если поиск закончила цель
+template <typename Connectivity, typename Predecessor, typename Storage,
+          typename Goal, typename Stop>
+bool breadthFirstUntil(Storage &storage, SearchWorkspace &workspace,
+                       int startIndex, Goal &&reachedGoal, Stop &&shouldStop) {
+    const int stride = storage.stride();
+    const auto offsets = neighbourOffsets<Connectivity>(stride);
+
+    std::vector<uint32_t> &queue = workspace.queue();
+
+    if constexpr (Predecessor::DIRECTIONS) {
+        workspace.visit(startIndex, Direction::NONE);
+    } else {
+        workspace.requireCosts();
+        workspace.mark(startIndex);
+        workspace.setCost(startIndex, 0);
+    }
+
+    if (reachedGoal(startIndex))
+        return true;
+    queue.push_back(startIndex);
+
+    for (size_t head = 0; head < queue.size(); ++head) {
+        if (head % STOP_CHECK_INTERVAL_cnt == 0 && shouldStop())
+            return false;
+
+        const int current = queue[head];
+        const int cx = current % stride - 1;
+        const int cy = current / stride - 1;
+
+        for (int dir = 0; dir < Connectivity::COUNT; ++dir) {
+            const int neighbor = current + offsets[dir];
+            if (workspace.isVisited(neighbor) ||
+                !canStep(storage, current, neighbor, dir, cx, cy, stride))
+                continue;
+
+            if constexpr (Predecessor::DIRECTIONS) {
+                workspace.visit(neighbor, dir);
+            } else {
+                workspace.mark(neighbor);
+                workspace.setCost(neighbor, workspace.cost(current) + 1);
+            }
+
+            // Все шаги равны, первое попадание в цель уже кратчайшее
+            if (reachedGoal(neighbor))
+                return true;
+            queue.push_back(neighbor);
+        }
+    }
+    return false;
+}
+
+// Одна цель; goalIndex < 0 - обход всей достижимой области
+template <typename Connectivity, typename Predecessor, typename Storage, typename Stop>
+bool breadthFirst(Storage &storage, SearchWorkspace &workspace,
+                  int startIndex, int goalIndex, Stop &&shouldStop) {
+    return breadthFirstUntil<Connectivity, Predecessor>(
+        storage, workspace, startIndex,
+        [goalIndex](int index) { return index == goalIndex; }, shouldStop);
+}
+
+// A* с допустимой согласованной эвристикой heuristic(x, y) - оценкой
+// стоимости от клетки до цели в единицах Cost. reachedGoal(index) вызывается
+// для клетки, когда ее стоимость окончательна, true - поиск закончен.
+// Возвращает true, если поиск закончила цель
+template <typename Connectivity, typename Cost, typename Predecessor,
+          typename Storage, typename Heuristic, typename Goal, typename Stop>
+bool bestFirstUntil(Storage &storage, SearchWorkspace &workspace, int startIndex,
+                    Heuristic &&heuristic, Goal &&reachedGoal, Stop &&shouldStop) {
+    const int stride = storage.stride();
+    const auto offsets = neighbourOffsets<Connectivity>(stride);
+
+    using HeapEntry = SearchWorkspace::HeapEntry;
+    std::vector<HeapEntry> &heap = workspace.heap();
+
+    // std::push_heap строит max-кучу, поэтому "меньше" - большая оценка.
+    // При равной оценке первой идет клетка с большей стоимостью, она ближе к цели
+    auto later = [](const HeapEntry &a, const HeapEntry &b) {
+        return a.estimate > b.estimate || (a.estimate == b.estimate && a.cost < b.cost);
+    };
+
+    auto record = [&workspace](int index, uint8_t dir, uint32_t cost) {
+        if constexpr (Predecessor::DIRECTIONS)
+            workspace.visit(index, dir);
+        else
+            workspace.mark(index);
+        workspace.setCost(index, cost);
+    };
+
+    workspace.requireCosts();
+    record(startIndex, Direction::NONE, 0);
+    heap.push_back({ static_cast<uint32_t>(heuristic(startIndex % stride - 1,
+                                                     startIndex / stride - 1)),
+                     0, static_cast<uint32_t>(startIndex) });
+
+    size_t expanded = 0;
+
+    while (!heap.empty()) {
+        if (expanded++ % STOP_CHECK_INTERVAL_cnt == 0 && shouldStop())
+            return false;
+
+        std::pop_heap(heap.begin(), heap.end(), later);
+        HeapEntry entry = heap.back();
+        heap.pop_back();
+
+        const int current = entry.index;
+        if (entry.cost > workspace.cost(current))
+            continue;
+
+        if (reachedGoal(current))
+            return true;
+
+        const int cx = current % stride - 1;
+        const int cy = current / stride - 1;
+
+        for (int dir = 0; dir < Connectivity::COUNT; ++dir) {
+            const int neighbor = current + offsets[dir];
+            const uint32_t cost = entry.cost +
+                (Direction::isDiagonal(dir) ? Cost::DIAGONAL : Cost::STRAIGHT);
+
+            if (workspace.isVisited(neighbor) && workspace.cost(neighbor) <= cost)
+                continue;
+            if (!canStep(storage, current, neighbor, dir, cx, cy, stride))
+                continue;
+
+            record(neighbor, dir, cost);
+            heap.push_back({ cost + static_cast<uint32_t>(heuristic(cx + Direction::DX[dir],
+                                                                    cy + Direction::DY[dir])),
+                             cost, static_cast<uint32_t>(neighbor) });
+            std::push_heap(heap.begin(), heap.end(), later);
+        }
+    }
+    return false;
+}
+
+template <typename Connectivity, typename Cost, typename Predecessor,
+          typename Storage, typename Heuristic, typename Stop>
+bool bestFirst(Storage &storage, SearchWorkspace &workspace, int startIndex, int goalIndex,
+               Heuristic &&heuristic, Stop &&shouldStop) {
+    return bestFirstUntil<Connectivity, Cost, Predecessor>(
+        storage, workspace, startIndex, heuristic,
+        [goalIndex](int index) { return index == goalIndex; }, shouldStop);
+}
+
+} // namespace SearchKernel
+
+#endif // SEARCHKERNEL_H
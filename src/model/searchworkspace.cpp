@@ -0,0 +1,49 @@
+#include <algorithm>
+#include <new>
+
+#include "searchworkspace.h"
+
+SearchWorkspace &SearchWorkspace::local() {
+    static thread_local SearchWorkspace workspace;
+    return workspace;
+}
+
+void SearchWorkspace::prepare(int width, int height) {
+    m_width = width;
+    m_height = height;
+
+    size_t cells = static_cast<size_t>(width) * static_cast<size_t>(height);
+
+    // Только растем: при уменьшении карты старые отметки просто не читаются
+    if (cells > m_capacity) {
+        m_visited.reset(static_cast<uint16_t *>(std::calloc(cells, sizeof(uint16_t))));
+        if (!m_visited)
+            throw std::bad_alloc();
+
+        m_cameFrom.reset(new uint8_t[cells]);
+        // Стоимости прежнего размера не держим, их выделит первый A*
+        m_cost.reset();
+        m_costCapacity = 0;
+        m_capacity = cells;
+        m_generation = 0;
+    }
+
+    ++m_generation;
+
+    // Счетчик переполнился - единственный случай, когда чистим все отметки
+    if (m_generation == 0) {
+        std::fill(m_visited.get(), m_visited.get() + m_capacity, 0);
+        m_generation = 1;
+    }
+
+    m_queue.clear();
+    m_heap.clear();
+}
+
+void SearchWorkspace::requireCosts() {
+    if (m_costCapacity >= m_capacity)
+        return;
+
+    m_cost.reset(new uint32_t[m_capacity]);
+    m_costCapacity = m_capacity;
+}
@@ -0,0 +1,109 @@
+#ifndef SEARCHWORKSPACE_H
+#define SEARCHWORKSPACE_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+// Рабочая область поиска, переживающая запросы. Живет по одному экземпляру
+// на поток (см. local()), поэтому не требует синхронизации.
+//
+// Посещенность хранится как "поколение" запроса: клетка посещена, если ее
+// отметка совпадает с текущим поколением. Очистка между запросами - это
+// инкремент счетчика, а не проход по всей карте.
+//
+// Массивы выделяются без заполнения (отметки - через calloc), поэтому
+// страницы памяти реально занимаются только в просмотренной области.
+// Стоимости нужны только A* и обходам без направлений: BFS с путем держит
+// отметки и cameFrom, 3 байта на клетку.
+class SearchWorkspace final {
+
+public:
+    // Элемент открытого списка A*: стоимость до клетки хранится в элементе,
+    // устаревшие элементы (стоимость больше текущей) пропускаются при извлечении
+    struct HeapEntry {
+        uint32_t estimate;
+        uint32_t cost;
+        uint32_t index;
+    };
+
+    static SearchWorkspace &local();
+
+    // Готовит область к новому запросу на карте width x height
+    void prepare(int width, int height);
+    // Выделяет стоимости под текущий размер; до setCost/relax в запросе
+    void requireCosts();
+
+    bool isVisited(int index) const {
+        return m_visited[index] == m_generation;
+    }
+
+    void visit(int index, uint8_t cameFrom) {
+        m_visited[index] = m_generation;
+        m_cameFrom[index] = cameFrom;
+    }
+
+    // Отметка без направления, для поисков, которым путь не нужен
+    void mark(int index) {
+        m_visited[index] = m_generation;
+    }
+
+    uint8_t cameFrom(int index) const {
+        return m_cameFrom[index];
+    }
+
+    // Стоимость пути до клетки, действительна только для посещенных
+    uint32_t cost(int index) const {
+        return m_cost[index];
+    }
+
+    void setCost(int index, uint32_t cost) {
+        m_cost[index] = cost;
+    }
+
+    void relax(int index, uint8_t cameFrom, uint32_t cost) {
+        visit(index, cameFrom);
+        m_cost[index] = cost;
+    }
+
+    int width() const {
+        return m_width;
+    }
+
+    // Очередь индексов клеток: элементы не удаляются, голову ведет сам поиск
+    std::vector<uint32_t> &queue() {
+        return m_queue;
+    }
+
+    // Открытый список A*, используется через std::push_heap/pop_heap
+    std::vector<HeapEntry> &heap() {
+        return m_heap;
+    }
+
+private:
+    struct FreeDeleter {
+        void operator()(void *data) const {
+            std::free(data);
+        }
+    };
+
+    SearchWorkspace() = default;
+
+    int m_width = 0;
+    int m_height = 0;
+
+    uint16_t m_generation = 0;
+
+    size_t m_capacity = 0;
+    std::unique_ptr<uint16_t[], FreeDeleter> m_visited;
+    // Читаются только для посещенных клеток, начальное содержимое не важно
+    std::unique_ptr<uint8_t[]> m_cameFrom;
+    // Выделяется по requireCosts()
+    std::unique_ptr<uint32_t[]> m_cost;
+    size_t m_costCapacity = 0;
+    std::vector<uint32_t> m_queue;
+    std::vector<HeapEntry> m_heap;
+};
+
+#endif // SEARCHWORKSPACE_H
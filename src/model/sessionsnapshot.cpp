@@ -0,0 +1,144 @@
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include "sessionsnapshot.h"
+#include "tracing.h"
+
+namespace {
+
+constexpr quint32 FILE_MAGIC = 0x50465353; // "PFSS"
+constexpr quint16 FILE_VERSION = 2;
+
+const char *const WORLD_FILE = "session.pfw";
+const char *const SESSION_FILE = "session.pfs";
+
+} // namespace
+
+QString SessionSnapshot::defaultDirectory() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+}
+
+bool SessionSnapshot::save(const QString &directory, GridModel *model,
+                           const PathFinder *pathFinder) {
+    TRACE_SPAN("session", "save");
+
+    if (model->width() <= 0 || model->height() <= 0)
+        return false;
+
+    QDir dir(directory);
+    if (!dir.mkpath(QStringLiteral(".")))
+        return false;
+
+    // Мир, как и файл сеанса ниже, заменяется целиком только после полной
+    // записи (ChunkedGrid::save)
+    if (!model->saveWorld(dir.filePath(WORLD_FILE)))
+        return false;
+
+    // landmarks() отдает только таблицу, которая соответствует карте
+    std::shared_ptr<const LandmarkTable> landmarks = pathFinder->landmarks();
+    if (landmarks && (landmarks->width() != model->width() ||
+                      landmarks->height() != model->height()))
+        landmarks.reset();
+
+    // Файл сеанса заменяется целиком, недописанный не подменит прежний
+    QSaveFile file(dir.filePath(SESSION_FILE));
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    {
+        QDataStream stream(&file);
+        stream << FILE_MAGIC << FILE_VERSION;
+        stream << model->worldStamp();
+        stream << qint32(model->width()) << qint32(model->height());
+        stream << model->startPoint() << model->endPoint();
+        stream << bool(landmarks);
+        if (stream.status() != QDataStream::Ok)
+            return false;
+    }
+
+    if (landmarks && !landmarks->save(&file))
+        return false;
+
+    return file.commit();
+}
+
+bool SessionSnapshot::read(const QString &directory) {
+    TRACE_SPAN("session", "read");
+
+    *this = SessionSnapshot();
+
+    QDir dir(directory);
+    QFile file(dir.filePath(SESSION_FILE));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    stream >> magic >> version;
+    if (magic != FILE_MAGIC || version != FILE_VERSION) {
+        qWarning() << "SessionSnapshot: неизвестный формат" << file.fileName();
+        return false;
+    }
+
+    quint64 worldStamp = 0;
+    qint32 width = 0;
+    qint32 height = 0;
+    QPoint start;
+    QPoint end;
+    bool hasLandmarks = false;
+    stream >> worldStamp >> width >> height >> start >> end >> hasLandmarks;
+    if (stream.status() != QDataStream::Ok || width <= 0 || height <= 0)
+        return false;
+
+    std::shared_ptr<const LandmarkTable> landmarks;
+    if (hasLandmarks) {
+        landmarks = LandmarkTable::load(&file);
+        // Без таблицы снимок годен: ее пересчитает PathFinder
+        if (!landmarks || landmarks->width() != width || landmarks->height() != height) {
+            qWarning() << "SessionSnapshot: таблица ориентиров повреждена";
+            landmarks.reset();
+        }
+    }
+
+    m_worldPath = dir.filePath(WORLD_FILE);
+    m_worldStamp = worldStamp;
+    m_width = width;
+    m_height = height;
+    m_start = start;
+    m_end = end;
+    m_landmarks = std::move(landmarks);
+    return true;
+}
+
+bool SessionSnapshot::isEmpty() const {
+    return m_width <= 0 || m_height <= 0;
+}
+
+bool SessionSnapshot::apply(GridModel *model, PathFinder *pathFinder) const {
+    TRACE_SPAN("session", "apply");
+
+    if (isEmpty() || !model->loadWorld(m_worldPath))
+        return false;
+
+    // Файл мира мог замениться отдельно от файла сеанса, в том числе миром
+    // тех же размеров - тогда ориентиры сеанса для него недопустимы
+    if (model->worldStamp() != m_worldStamp ||
+        model->width() != m_width || model->height() != m_height) {
+        qWarning() << "SessionSnapshot: мир не совпадает с файлом сеанса";
+        return true;
+    }
+
+    model->setStartPoint(m_start);
+    model->setEndPoint(m_end);
+
+    // Заменяет расчет, запущенный подключением мира
+    if (m_landmarks)
+        pathFinder->setLandmarks(m_landmarks);
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef SESSIONSNAPSHOT_H
+#define SESSIONSNAPSHOT_H
+
+#include <QPoint>
+#include <QString>
+
+#include <memory>
+
+#include "gridmodel.h"
+#include "landmarktable.h"
+#include "pathfinder.h"
+
+// Снимок сеанса: карта, точки А/Б и таблица ориентиров ALT, чтобы новый
+// запуск не генерировал и не пересчитывал все заново.
+//
+// Карта - файл мира ChunkedGrid: при подключении читаются заголовок и
+// каталог блоков, сами блоки - по мере обращения. Точки и таблица - в файле
+// сеанса рядом вместе с отметкой файла мира: таблица, посчитанная для
+// другого мира тех же размеров, не подключается. read() не трогает модель и может идти в фоне, apply()
+// подключает прочитанное к модели в ее потоке.
+class SessionSnapshot final {
+
+public:
+    static QString defaultDirectory();
+
+    // Таблица ориентиров пишется, только если она соответствует карте
+    static bool save(const QString &directory, GridModel *model, const PathFinder *pathFinder);
+
+    // Файл сеанса с таблицей ориентиров. false - снимка нет или он поврежден
+    bool read(const QString &directory);
+    bool isEmpty() const;
+
+    // Подключение мира, точки А/Б и готовая таблица вместо фонового расчета
+    bool apply(GridModel *model, PathFinder *pathFinder) const;
+
+private:
+    QString m_worldPath;
+    quint64 m_worldStamp = 0;
+    int m_width = 0;
+    int m_height = 0;
+    QPoint m_start { -1, -1 };
+    QPoint m_end { -1, -1 };
+    std::shared_ptr<const LandmarkTable> m_landmarks;
+};
+
+#endif // SESSIONSNAPSHOT_H
@@ -0,0 +1,186 @@
+#include "tracing.h"
+
+#ifdef PATHFINDER_TRACING
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// Событий на поток; старые перезаписываются
+constexpr size_t BUFFER_EVENT_cnt = size_t(1) << 16;
+
+using Clock = std::chrono::steady_clock;
+const Clock::time_point g_epoch = Clock::now();
+
+struct Event {
+    const char *category;
+    const char *name;
+    qint64 start_ns;
+    qint64 duration_ns;
+    quint64 id;
+    char phase;
+};
+
+struct ThreadBuffer {
+    int tid = 0;
+    QString threadName;
+    std::unique_ptr<Event[]> events { new Event[BUFFER_EVENT_cnt] };
+    // Пишет только владелец, dump читает до этой границы
+    std::atomic<size_t> written { 0 };
+};
+
+QMutex g_registryMutex;
+// Буферы переживают свои потоки, чтобы их события попали в выгрузку
+std::vector<std::shared_ptr<ThreadBuffer>> g_buffers;
+std::atomic<quint64> g_nextId { 1 };
+
+std::shared_ptr<ThreadBuffer> registerThread() {
+    auto buffer = std::make_shared<ThreadBuffer>();
+
+    QMutexLocker locker(&g_registryMutex);
+    buffer->tid = static_cast<int>(g_buffers.size()) + 1;
+
+    QThread *thread = QThread::currentThread();
+    buffer->threadName = thread && !thread->objectName().isEmpty()
+        ? thread->objectName()
+        : QStringLiteral("Thread %1").arg(buffer->tid);
+
+    g_buffers.push_back(buffer);
+    return buffer;
+}
+
+void record(const Event &event) {
+    static thread_local std::shared_ptr<ThreadBuffer> buffer = registerThread();
+
+    size_t index = buffer->written.load(std::memory_order_relaxed);
+    buffer->events[index % BUFFER_EVENT_cnt] = event;
+    buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void appendEscaped(QByteArray &out, const QByteArray &text) {
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            out.append('\\');
+        if (static_cast<unsigned char>(c) >= 0x20)
+            out.append(c);
+    }
+}
+
+void appendMicros(QByteArray &out, qint64 ns) {
+    out.append(QByteArray::number(ns / 1000));
+    out.append('.');
+    out.append(QByteArray::number(ns % 1000).rightJustified(3, '0'));
+}
+
+} // namespace
+
+namespace Tracing {
+
+qint64 now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - g_epoch).count();
+}
+
+void complete(const char *category, const char *name, qint64 start_ns, qint64 duration_ns) {
+    record({ category, name, start_ns, duration_ns, 0, 'X' });
+}
+
+void instant(const char *category, const char *name) {
+    record({ category, name, now_ns(), 0, 0, 'i' });
+}
+
+quint64 nextId() {
+    return g_nextId.fetch_add(1, std::memory_order_relaxed);
+}
+
+void asyncBegin(const char *category, const char *name, quint64 id) {
+    record({ category, name, now_ns(), 0, id, 'b' });
+}
+
+void asyncEnd(const char *category, const char *name, quint64 id) {
+    record({ category, name, now_ns(), 0, id, 'e' });
+}
+
+bool dump(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    const qint64 pid = QCoreApplication::applicationPid();
+
+    QByteArray out;
+    out.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+
+    auto beginEvent = [&](const Event &event, int tid) {
+        if (!first)
+            out.append(",\n");
+        first = false;
+
+        out.append("{\"cat\":\"");
+        appendEscaped(out, event.category);
+        out.append("\",\"name\":\"");
+        appendEscaped(out, event.name);
+        out.append("\",\"ph\":\"").append(event.phase);
+        out.append("\",\"pid\":").append(QByteArray::number(pid));
+        out.append(",\"tid\":").append(QByteArray::number(tid));
+        out.append(",\"ts\":");
+        appendMicros(out, event.start_ns);
+    };
+
+    QMutexLocker locker(&g_registryMutex);
+
+    for (const auto &buffer : g_buffers) {
+        // Имя потока для просмотрщика
+        if (!first)
+            out.append(",\n");
+        first = false;
+        out.append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":").append(QByteArray::number(pid));
+        out.append(",\"tid\":").append(QByteArray::number(buffer->tid));
+        out.append(",\"args\":{\"name\":\"");
+        appendEscaped(out, buffer->threadName.toUtf8());
+        out.append("\"}}");
+
+        size_t written = buffer->written.load(std::memory_order_acquire);
+        size_t from = written > BUFFER_EVENT_cnt ? written - BUFFER_EVENT_cnt : 0;
+
+        for (size_t i = from; i < written; ++i) {
+            const Event &event = buffer->events[i % BUFFER_EVENT_cnt];
+            beginEvent(event, buffer->tid);
+
+            switch (event.phase) {
+            case 'X':
+                out.append(",\"dur\":");
+                appendMicros(out, event.duration_ns);
+                break;
+            case 'i':
+                out.append(",\"s\":\"t\"");
+                break;
+            default:
+                out.append(",\"id\":").append(QByteArray::number(event.id));
+                break;
+            }
+            out.append('}');
+
+            // Файл пишется частями, чтобы не держать всю выгрузку в памяти
+            if (out.size() > (1 << 20)) {
+                if (file.write(out) != out.size())
+                    return false;
+                out.clear();
+            }
+        }
+    }
+
+    out.append("\n]}\n");
+    return file.write(out) == out.size();
+}
+
+} // namespace Tracing
+
+#endif // PATHFINDER_TRACING
@@ -0,0 +1,81 @@
+#ifndef TRACING_H
+#define TRACING_H
+
+// Трассировка конвейера запросов в формате Chrome trace (chrome://tracing,
+// ui.perfetto.dev). Включается опцией сборки PATHFINDER_TRACING; без нее
+// макросы ниже раскрываются в пустоту и в коде не остается ни вызовов,
+// ни данных.
+//
+// Каждый поток пишет в свой кольцевой буфер без блокировок; при переполнении
+// теряются самые старые события. dump() собирает буферы всех потоков,
+// вызывать его лучше в затишье: событие, перезаписанное во время выгрузки,
+// может попасть в файл испорченным.
+//
+// Имена и категории - строковые литералы: хранится только указатель.
+
+#ifdef PATHFINDER_TRACING
+
+#include <QString>
+
+#include <chrono>
+#include <cstdint>
+
+namespace Tracing {
+
+qint64 now_ns();
+
+// Завершенный интервал: одно событие на весь интервал
+void complete(const char *category, const char *name, qint64 start_ns, qint64 duration_ns);
+// Мгновенное событие, например отправка сигнала
+void instant(const char *category, const char *name);
+// Асинхронный интервал, который начинается и заканчивается в разных потоках
+// (ожидание в очереди); концы связываются по id
+quint64 nextId();
+void asyncBegin(const char *category, const char *name, quint64 id);
+void asyncEnd(const char *category, const char *name, quint64 id);
+
+bool dump(const QString &path);
+
+class Span final {
+
+public:
+    Span(const char *category, const char *name)
+        : m_category(category), m_name(name), m_start_ns(now_ns()) {
+    }
+
+    ~Span() {
+        complete(m_category, m_name, m_start_ns, now_ns() - m_start_ns);
+    }
+
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+
+private:
+    const char *m_category;
+    const char *m_name;
+    qint64 m_start_ns;
+};
+
+} // namespace Tracing
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+#define TRACE_SPAN(category, name) \
+    Tracing::Span TRACE_CONCAT(traceSpan, __LINE__)(category, name)
+#define TRACE_INSTANT(category, name) Tracing::instant(category, name)
+#define TRACE_NEXT_ID() Tracing::nextId()
+#define TRACE_ASYNC_BEGIN(category, name, id) Tracing::asyncBegin(category, name, id)
+#define TRACE_ASYNC_END(category, name, id) Tracing::asyncEnd(category, name, id)
+
+#else
+
+#define TRACE_SPAN(category, name) ((void)0)
+#define TRACE_INSTANT(category, name) ((void)0)
+#define TRACE_NEXT_ID() quint64(0)
+#define TRACE_ASYNC_BEGIN(category, name, id) ((void)(id))
+#define TRACE_ASYNC_END(category, name, id) ((void)(id))
+
+#endif // PATHFINDER_TRACING
+
+#endif // TRACING_H
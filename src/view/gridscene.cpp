@@ -1,8 +1,19 @@
 #include "gridscene.h"
+#include <QGraphicsEllipseItem>
+#include <QGraphicsPathItem>
 #include <QGraphicsRectItem>
+#include <QPainter>
+#include <QPainterPath>
 #include <QPen>
 #include <QBrush>
 #include <QDebug>
+#include <QFuture>
+
+#include <algorithm>
+#include <cmath>
+
+#include "../model/pathsimplifier.h"
+#include "../model/tracing.h"
 
 GridScene::GridScene(GridModel *model, PathFinder *pathFinder, QObject *parent)
     : QGraphicsScene(parent), m_model(model), m_pathFinder(pathFinder) {
@@ -12,6 +23,7 @@ GridScene::GridScene(GridModel *model, PathFinder *pathFinder, QObject *parent)
     connect(&m_previewTimer, &QTimer::timeout, this, &GridScene::onPreviewTimerTimeout);
 
     connect(m_model, &GridModel::gridChanged, this, &GridScene::onGridChanged);
+    connect(m_model, &GridModel::cellsChanged, this, &GridScene::onCellsChanged);
     connect(m_pathFinder, &PathFinder::pathFound, this, &GridScene::onPathFound);
 
     setBackgroundBrush(QBrush(Qt::lightGray));
@@ -20,57 +32,90 @@ GridScene::GridScene(GridModel *model, PathFinder *pathFinder, QObject *parent)
 GridScene::~GridScene() {
     // На всякий случай чистим все элементы
     clearAllPathItems();
+    clearAgentItems();
 }
 
 void GridScene::drawGrid() {
+    TRACE_SPAN("scene", "drawGrid");
+
     clear();
 
     m_mainPathItems.clear();
     m_previewPathItems.clear();
+    m_agentItems.clear();
+    m_startLabel = nullptr;
+    m_endLabel = nullptr;
+
+    setSceneRect(QRectF(0, 0, std::max(0, m_model->width()) * CELL_SIZE,
+                        std::max(0, m_model->height()) * CELL_SIZE));
+    // Сами клетки перерисует drawBackground
+    update();
 
     if (m_model->width() <= 0 || m_model->height() <= 0)
         return;
 
-    for (int y = 0; y < m_model->height(); ++y) {
-        for (int x = 0; x < m_model->width(); ++x) {
-            auto cellType = m_model->getCell(x, y);
-            auto color = getCellColor(cellType);
-
-            QGraphicsRectItem *rect = new QGraphicsRectItem(
-                x * CELL_SIZE, y * CELL_SIZE, CELL_SIZE, CELL_SIZE);
+    updatePointLabels();
+    onAgentsChanged();
+}
 
-            rect->setBrush(QBrush(color));
-            rect->setPen(QPen(Qt::black, 1));
-            rect->setData(0, QPoint(x, y));
+void GridScene::drawBackground(QPainter *painter, const QRectF &rect) {
+    TRACE_SPAN("scene", "drawBackground");
 
-            addItem(rect);
+    QGraphicsScene::drawBackground(painter, rect);
 
-            if (cellType == CellType::Start || cellType == CellType::End) {
-                QString letter = (cellType == CellType::Start) ? tr("A") : tr("Б");
-                QColor textColor = (cellType == CellType::Start) ? Qt::black : Qt::white;
+    const int width = m_model->width();
+    const int height = m_model->height();
+    if (width <= 0 || height <= 0)
+        return;
 
-                QGraphicsTextItem *textItem = new QGraphicsTextItem(letter);
-                textItem->setDefaultTextColor(textColor);
-                textItem->setFont(QFont("Arial", 12, QFont::Bold));
+    QRect cells(QPoint(static_cast<int>(std::floor(rect.left() / CELL_SIZE)),
+                       static_cast<int>(std::floor(rect.top() / CELL_SIZE))),
+                QPoint(static_cast<int>(std::floor(rect.right() / CELL_SIZE)),
+                       static_cast<int>(std::floor(rect.bottom() / CELL_SIZE))));
+    cells = cells.intersected(QRect(0, 0, width, height));
+    if (cells.isEmpty())
+        return;
 
-                QRectF textRect = textItem->boundingRect();
-                textItem->setPos(
-                    x * CELL_SIZE + (CELL_SIZE - textRect.width()) / 2,
-                    y * CELL_SIZE + (CELL_SIZE - textRect.height()) / 2
-                    );
+    // При сильном отдалении клетка меньше пикселя: рисуем по одной клетке
+    // на блок step x step, работа ограничена числом пикселей, а не клеток
+    const qreal cellPx = CELL_SIZE * painter->worldTransform().m11();
+    const int step = cellPx >= 1.0 ? 1 : static_cast<int>(std::ceil(1.0 / cellPx));
 
-                addItem(textItem);
-            }
+    ChunkedGrid::Cursor grid = m_model->cursor();
+    for (int y = cells.top() / step * step; y <= cells.bottom(); y += step) {
+        for (int x = cells.left() / step * step; x <= cells.right(); x += step) {
+            painter->fillRect(QRect(x * CELL_SIZE, y * CELL_SIZE, step * CELL_SIZE, step * CELL_SIZE),
+                              getCellColor(grid.cell(x, y)));
         }
     }
 
-    QRectF sceneRect(0, 0, m_model->width() * CELL_SIZE, m_model->height() * CELL_SIZE);
-    setSceneRect(sceneRect);
+    if (cellPx < MIN_GRID_LINE_px)
+        return;
+
+    painter->setPen(QPen(Qt::black, 1));
+    for (int x = cells.left(); x <= cells.right() + 1; ++x)
+        painter->drawLine(x * CELL_SIZE, cells.top() * CELL_SIZE,
+                          x * CELL_SIZE, (cells.bottom() + 1) * CELL_SIZE);
+    for (int y = cells.top(); y <= cells.bottom() + 1; ++y)
+        painter->drawLine(cells.left() * CELL_SIZE, y * CELL_SIZE,
+                          (cells.right() + 1) * CELL_SIZE, y * CELL_SIZE);
+}
+
+void GridScene::setPlanner(CooperativePlanner *planner) {
+    if (m_planner)
+        disconnect(m_planner, nullptr, this, nullptr);
+
+    m_planner = planner;
+    if (m_planner)
+        connect(m_planner, &CooperativePlanner::agentsChanged, this, &GridScene::onAgentsChanged);
+
+    onAgentsChanged();
 }
 
 void GridScene::clearPath() {
-    m_currentPath.clear();
-    m_previewPath.clear();
+    m_previewToken.cancel();
+    m_currentPath.reset();
+    m_previewPath.reset();
     clearAllPathItems();
 }
 
@@ -90,14 +135,23 @@ void GridScene::clearPreviewPathItems() {
     m_previewPathItems.clear();
 }
 
+void GridScene::clearAgentItems() {
+    for (auto* item : m_agentItems) {
+        removeItem(item);
+        delete item;
+    }
+    m_agentItems.clear();
+}
+
 void GridScene::clearAllPathItems() {
     clearMainPathItems();
     clearPreviewPathItems();
 }
 
-QGraphicsRectItem* GridScene::createMainPathItem(const QPoint& point) {
+QGraphicsRectItem* GridScene::createMainPathItem(const QRect& cells) {
     QGraphicsRectItem *pathRect = new QGraphicsRectItem(
-        point.x() * CELL_SIZE, point.y() * CELL_SIZE, CELL_SIZE, CELL_SIZE);
+        cells.x() * CELL_SIZE, cells.y() * CELL_SIZE,
+        cells.width() * CELL_SIZE, cells.height() * CELL_SIZE);
 
     pathRect->setBrush(QBrush(Qt::blue));
     pathRect->setPen(QPen(Qt::black, 1));
@@ -122,9 +176,9 @@ bool GridScene::shouldSkipPathPoint(const QPoint& point, bool isPreview) const {
         return true;
 
     if (isPreview) {
-        if (point == m_previewPath.back())
+        if (point == m_previewPath->end())
             return true;
-        if (std::find(m_currentPath.begin(), m_currentPath.end(), point) != m_currentPath.end())
+        if (m_currentPath && m_currentPath->contains(point))
             return true;
     }
 
@@ -135,19 +189,157 @@ void GridScene::onGridChanged() {
     drawGrid();
 }
 
-void GridScene::onPathFound(const std::vector<QPoint> &path, bool isPreview) {
+void GridScene::onCellsChanged(const GridDelta &delta) {
+    TRACE_SPAN("scene", "onCellsChanged");
+
+    // Перерисовываем только изменившуюся область, сцену не перестраиваем
+    if (!delta.region.isEmpty())
+        update(QRectF(delta.region.x() * CELL_SIZE, delta.region.y() * CELL_SIZE,
+                      delta.region.width() * CELL_SIZE, delta.region.height() * CELL_SIZE));
+
+    updatePointLabels();
+}
+
+void GridScene::updatePointLabels() {
+    for (auto **label : { &m_startLabel, &m_endLabel }) {
+        if (*label) {
+            removeItem(*label);
+            delete *label;
+            *label = nullptr;
+        }
+    }
+
+    if (m_model->isValidPoint(m_model->startPoint()))
+        m_startLabel = createPointLabel(m_model->startPoint(), tr("A"), Qt::black);
+    if (m_model->isValidPoint(m_model->endPoint()))
+        m_endLabel = createPointLabel(m_model->endPoint(), tr("Б"), Qt::white);
+}
+
+QGraphicsTextItem* GridScene::createPointLabel(const QPoint &point, const QString &letter,
+                                               const QColor &color) {
+    QGraphicsTextItem *textItem = new QGraphicsTextItem(letter);
+    textItem->setDefaultTextColor(color);
+    textItem->setFont(QFont("Arial", 12, QFont::Bold));
+
+    QRectF textRect = textItem->boundingRect();
+    textItem->setPos(
+        point.x() * CELL_SIZE + (CELL_SIZE - textRect.width()) / 2,
+        point.y() * CELL_SIZE + (CELL_SIZE - textRect.height()) / 2
+        );
+
+    addItem(textItem);
+    return textItem;
+}
+
+void GridScene::paintStroke(const QPoint &from, const QPoint &to) {
+    // Брезенхем: при быстром движении мыши клетки между событиями не теряются
+    int x = from.x();
+    int y = from.y();
+    int dx = std::abs(to.x() - x);
+    int dy = -std::abs(to.y() - y);
+    int sx = x < to.x() ? 1 : -1;
+    int sy = y < to.y() ? 1 : -1;
+    int error = dx + dy;
+
+    for (;;) {
+        CellType type = m_model->getCell(x, y);
+        if (m_model->isValidPoint(QPoint(x, y)) &&
+            type != CellType::Start && type != CellType::End)
+            m_model->setCell(x, y, m_paintType);
+
+        if (x == to.x() && y == to.y())
+            break;
+
+        int doubled = 2 * error;
+        if (doubled >= dy) {
+            error += dy;
+            x += sx;
+        }
+        if (doubled <= dx) {
+            error += dx;
+            y += sy;
+        }
+    }
+
+    // Правка опубликуется при отпускании кнопки, а клетки сцена читает
+    // из модели - перерисовываем отрезок сами
+    QRect segment = QRect(from, to).normalized();
+    update(QRectF(segment.x() * CELL_SIZE, segment.y() * CELL_SIZE,
+                  segment.width() * CELL_SIZE, segment.height() * CELL_SIZE));
+}
+
+void GridScene::endStroke() {
+    if (!m_painting)
+        return;
+
+    m_painting = false;
+    m_model->commitEdit();
+}
+
+void GridScene::onPathFound(PathPtr path, bool isPreview) {
+    TRACE_SPAN("scene", isPreview ? "previewPath" : "mainPath");
+
     if (isPreview) {
-        m_previewPath = path;
+        m_previewPath = std::move(path);
         updatePreviewPath();
     } else {
-        m_currentPath = path;
+        m_currentPath = std::move(path);
         updateMainPathDisplay();
     }
 }
 
+void GridScene::onAgentsChanged() {
+    TRACE_SPAN("scene", "onAgentsChanged");
+
+    clearAgentItems();
+
+    if (!m_planner)
+        return;
+
+    const auto &agents = m_planner->agents();
+    const qreal half = CELL_SIZE / 2.0;
+
+    for (size_t i = 0; i < agents.size(); ++i) {
+        const auto &agent = agents[i];
+
+        // Цвет по золотому сечению: соседние агенты различимы при любом количестве
+        QColor color = QColor::fromHsvF(std::fmod(i * 0.618034, 1.0), 0.8, 0.9);
+
+        QPainterPath planPath(QPointF(agent.position.x() * CELL_SIZE + half,
+                                      agent.position.y() * CELL_SIZE + half));
+        for (const auto &point : agent.plan)
+            planPath.lineTo(point.x() * CELL_SIZE + half, point.y() * CELL_SIZE + half);
+
+        QGraphicsPathItem *planItem = new QGraphicsPathItem(planPath);
+        planItem->setPen(QPen(color, 3));
+        addItem(planItem);
+        m_agentItems.push_back(planItem);
+
+        QGraphicsEllipseItem *agentItem = new QGraphicsEllipseItem(
+            agent.position.x() * CELL_SIZE + 4, agent.position.y() * CELL_SIZE + 4,
+            CELL_SIZE - 8, CELL_SIZE - 8);
+        agentItem->setBrush(QBrush(color));
+        agentItem->setPen(QPen(Qt::black, 1));
+        addItem(agentItem);
+        m_agentItems.push_back(agentItem);
+    }
+}
+
 void GridScene::mousePressEvent(QGraphicsSceneMouseEvent *event) {
     QPoint gridPos = sceneToGrid(event->scenePos());
 
+    if (event->button() == Qt::RightButton && m_model->isValidPoint(gridPos)) {
+        endStroke();
+        m_model->beginEdit();
+        m_painting = true;
+        m_paintType = (event->modifiers() & Qt::ControlModifier) ? CellType::Empty
+                                                                 : CellType::Wall;
+        m_lastPaintPoint = gridPos;
+        paintStroke(gridPos, gridPos);
+        event->accept();
+        return;
+    }
+
     if (m_model->isValidPoint(gridPos) && event->button() == Qt::LeftButton) {
         if (!m_model->isWalkable(gridPos.x(), gridPos.y())) {
             QGraphicsScene::mousePressEvent(event);
@@ -179,12 +371,25 @@ void GridScene::mousePressEvent(QGraphicsSceneMouseEvent *event) {
 void GridScene::mouseMoveEvent(QGraphicsSceneMouseEvent *event) {
     QPoint gridPos = sceneToGrid(event->scenePos());
 
+    if (m_painting && (event->buttons() & Qt::RightButton)) {
+        if (gridPos != m_lastPaintPoint) {
+            paintStroke(m_lastPaintPoint, gridPos);
+            m_lastPaintPoint = gridPos;
+        }
+        event->accept();
+        return;
+    }
+
+    // Отпускание могло уйти мимо сцены
+    endStroke();
+
     if (!m_model->isValidPoint(m_model->startPoint())) {
-        if (!m_previewPath.empty()) {
-            m_previewPath.clear();
+        if (m_previewPath) {
+            m_previewPath.reset();
             updatePreviewPath();
         }
         m_previewTimer.stop();
+        m_previewToken.cancel();
         QGraphicsScene::mouseMoveEvent(event);
         return;
     }
@@ -199,8 +404,9 @@ void GridScene::mouseMoveEvent(QGraphicsSceneMouseEvent *event) {
     }
     else {
         m_previewTimer.stop();
-        if (!m_previewPath.empty()) {
-            m_previewPath.clear();
+        m_previewToken.cancel();
+        if (m_previewPath) {
+            m_previewPath.reset();
             updatePreviewPath();
         }
     }
@@ -208,6 +414,13 @@ void GridScene::mouseMoveEvent(QGraphicsSceneMouseEvent *event) {
     QGraphicsScene::mouseMoveEvent(event);
 }
 
+void GridScene::mouseReleaseEvent(QGraphicsSceneMouseEvent *event) {
+    if (event->button() == Qt::RightButton)
+        endStroke();
+
+    QGraphicsScene::mouseReleaseEvent(event);
+}
+
 QColor GridScene::getCellColor(CellType type) const {
     switch (type) {
     case CellType::Empty:   return Qt::white;
@@ -229,49 +442,76 @@ QPoint GridScene::sceneToGrid(const QPointF &scenePos) const {
 void GridScene::updatePreviewPath() {
     clearPreviewPathItems();
 
-    if (m_previewPath.empty())
+    if (!m_previewPath || m_previewPath->isEmpty())
         return;
 
-    for (const auto &point : m_previewPath) {
-        if (shouldSkipPathPoint(point, true)) {
-            continue;
-        }
+    m_previewPath->forEach([this](const QPoint &point) {
+        if (shouldSkipPathPoint(point, true))
+            return;
 
         QGraphicsRectItem* previewRect = createPreviewPathItem(point);
         addItem(previewRect);
         m_previewPathItems.push_back(previewRect);
-    }
+    });
 }
 
 void GridScene::updateMainPathDisplay() {
     clearMainPathItems();
 
-    if (m_currentPath.empty())
+    if (!m_currentPath || m_currentPath->isEmpty())
         return;
 
-    for (const auto &point : m_currentPath) {
-        if (shouldSkipPathPoint(point, false)) {
-            continue;
-        }
-
-        QGraphicsRectItem* pathRect = createMainPathItem(point);
+    auto addRect = [this](const QRect &cells) {
+        QGraphicsRectItem* pathRect = createMainPathItem(cells);
         addItem(pathRect);
         m_mainPathItems.push_back(pathRect);
+    };
+
+    // Прямой участок - один прямоугольник, элементов по числу поворотов.
+    // Первая клетка участка - конец предыдущего (или А), последняя у пути - Б
+    const std::vector<QPoint> corners = PathSimplifier::collinear(*m_currentPath);
+
+    for (size_t i = 1; i < corners.size(); ++i) {
+        const QPoint step((corners[i].x() > corners[i - 1].x()) - (corners[i].x() < corners[i - 1].x()),
+                          (corners[i].y() > corners[i - 1].y()) - (corners[i].y() < corners[i - 1].y()));
+        const QPoint first = corners[i - 1] + step;
+        const QPoint last = i + 1 == corners.size() ? corners[i] - step : corners[i];
+
+        if (step.x() != 0 && step.y() != 0) {
+            for (QPoint point = first; point != last + step; point += step) {
+                if (!shouldSkipPathPoint(point, false))
+                    addRect(QRect(point, QSize(1, 1)));
+            }
+        } else if (first != last + step) {
+            addRect(QRect(QPoint(std::min(first.x(), last.x()), std::min(first.y(), last.y())),
+                          QPoint(std::max(first.x(), last.x()), std::max(first.y(), last.y()))));
+        }
     }
 }
 
 void GridScene::onPreviewTimerTimeout() {
+    TRACE_SPAN("scene", "previewTimer");
+
     if (m_model->isValidPoint(m_pendingPreviewPoint) &&
         m_model->isValidPoint(m_model->startPoint()) &&
         m_model->isWalkable(m_pendingPreviewPoint.x(), m_pendingPreviewPoint.y()) &&
         m_pendingPreviewPoint != m_model->startPoint()) {
 
-        QMetaObject::invokeMethod(m_pathFinder, "findPath", Qt::QueuedConnection,
-                                  Q_ARG(QPoint, m_pendingPreviewPoint),
-                                  Q_ARG(bool, true));
+        m_previewToken.cancel();
+        m_previewToken = CancellationToken();
+
+        m_pathFinder->findPathAsync(m_model->startPoint(), m_pendingPreviewPoint, m_previewToken)
+            .then(this, [this, token = m_previewToken](PathPtr path) {
+                TRACE_INSTANT("signal", "previewDelivered");
+
+                // Результат мог успеть прийти уже после отмены
+                if (!token.isCancelled())
+                    onPathFound(std::move(path), true);
+            });
     } else {
-        if (!m_previewPath.empty()) {
-            m_previewPath.clear();
+        m_previewToken.cancel();
+        if (m_previewPath) {
+            m_previewPath.reset();
             updatePreviewPath();
         }
     }
@@ -7,6 +7,7 @@
 
 #include <vector>
 
+#include "../model/cooperativeplanner.h"
 #include "../model/gridmodel.h"
 #include "../model/pathfinder.h"
 
@@ -15,6 +16,8 @@ class GridScene final : public QGraphicsScene {
 
     static constexpr int CELL_SIZE = 30;
     static constexpr int INTERVAL_ms = 50;
+    // Мельче этого клетка на экране рисуется без сетки
+    static constexpr int MIN_GRID_LINE_px = 4;
 
 public:
     explicit GridScene(GridModel *model, PathFinder *pathFinder, QObject *parent = nullptr);
@@ -23,30 +26,60 @@ public:
     void drawGrid();
     void clearPath();
 
+    // Отображение агентов кооперативного поиска и их планов
+    void setPlanner(CooperativePlanner *planner);
+
 public slots:
     void onGridChanged();
-    void onPathFound(const std::vector<QPoint> &path, bool isPreview);
+    void onCellsChanged(const GridDelta &delta);
+    void onPathFound(PathPtr path, bool isPreview);
+    void onAgentsChanged();
 
 protected:
+    // Клетки рисуются фоном и только в открытой области: сцена не держит
+    // элемент на клетку, и большая карта не строит их при загрузке
+    void drawBackground(QPainter *painter, const QRectF &rect) override;
+
     void mousePressEvent(QGraphicsSceneMouseEvent *event) override;
     void mouseMoveEvent(QGraphicsSceneMouseEvent *event) override;
+    void mouseReleaseEvent(QGraphicsSceneMouseEvent *event) override;
 
 private:
     GridModel *m_model;
     PathFinder *m_pathFinder;
+    CooperativePlanner *m_planner = nullptr;
+
+    // Пути для отрисовки, разделяются с PathFinder без копирования
+    PathPtr m_currentPath;
+    PathPtr m_previewPath;
 
-    // Вектора путей для отрисовки
-    std::vector<QPoint> m_currentPath;
-    std::vector<QPoint> m_previewPath;
+    QGraphicsTextItem *m_startLabel = nullptr;
+    QGraphicsTextItem *m_endLabel = nullptr;
+
+    // Рисование стен протяжкой ПКМ: вся протяжка от нажатия до отпускания -
+    // одна правка модели
+    bool m_painting = false;
+    CellType m_paintType = CellType::Wall;
+    QPoint m_lastPaintPoint;
 
     // Вектора указателей на элементы путей для обработки
     std::vector<QGraphicsRectItem*> m_mainPathItems;
     std::vector<QGraphicsRectItem*> m_previewPathItems;
+    // По два элемента на агента: линия плана и сам агент
+    std::vector<QGraphicsItem*> m_agentItems;
 
     QTimer m_previewTimer;
     QPoint m_pendingPreviewPoint;
+    // Токен последнего запроса предпросмотра: новый запрос отменяет старый
+    CancellationToken m_previewToken;
 
     QColor getCellColor(CellType type) const;
+    void updatePointLabels();
+    QGraphicsTextItem* createPointLabel(const QPoint &point, const QString &letter,
+                                        const QColor &color);
+    void paintStroke(const QPoint &from, const QPoint &to);
+    void endStroke();
+
     QPoint sceneToGrid(const QPointF &scenePos) const;
 
     void updatePreviewPath();
@@ -55,7 +88,8 @@ private:
     void clearMainPathItems();
     void clearPreviewPathItems();
     void clearAllPathItems();
-    QGraphicsRectItem* createMainPathItem(const QPoint& point);
+    void clearAgentItems();
+    QGraphicsRectItem* createMainPathItem(const QRect& cells);
     QGraphicsRectItem* createPreviewPathItem(const QPoint& point);
     bool shouldSkipPathPoint(const QPoint& point, bool isPreview) const;
 
@@ -1,5 +1,6 @@
 #include <QGraphicsView>
 #include <QDockWidget>
+#include <QCheckBox>
 #include <QSpinBox>
 #include <QPushButton>
 #include <QLabel>
@@ -8,12 +9,20 @@
 #include <QMessageBox>
 #include <QCloseEvent>
 #include <QWheelEvent>
+#include <QFileDialog>
+#include <QDebug>
+#include <QShortcut>
+#include <QtConcurrent>
 
+#include "../model/cooperativeplanner.h"
 #include "../model/gridmodel.h"
 #include "../model/pathfinder.h"
+#include "../model/sessionsnapshot.h"
+#include "../model/tracing.h"
 
 #include "mainwindow.h"
 #include "gridscene.h"
+#include "minimapwidget.h"
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -22,17 +31,26 @@ MainWindow::MainWindow(QWidget *parent)
     , m_heightSpinBox(nullptr)
     , m_generateButton(nullptr)
     , m_findPathButton(nullptr)
+    , m_agentsSpinBox(nullptr)
+    , m_agentsButton(nullptr)
+    , m_diagonalCheckBox(nullptr)
+    , m_weightedCheckBox(nullptr)
     , m_instructionsLabel(nullptr)
     , m_widthLabel(nullptr)
     , m_heightLabel(nullptr)
-    , m_scene(nullptr)
     , m_model(new GridModel(this))
     , m_pathFinder(new PathFinder(m_model, nullptr))
+    , m_planner(new CooperativePlanner(m_model, this))
+    , m_scene(nullptr)
+    , m_minimap(nullptr)
     , m_settings("PathFinder", "PathFindingApp") {
 
     setupUI();
     setupConnections();
     restoreWindowState();
+
+    // Окно показывается сразу, снимок сеанса подтягивается следом
+    QTimer::singleShot(0, this, &MainWindow::restoreSession);
 }
 
 MainWindow::~MainWindow() { }
@@ -42,6 +60,7 @@ void MainWindow::setupUI() {
 
     m_graphicsView = new QGraphicsView(this);
     m_scene = new GridScene(m_model, m_pathFinder, this);
+    m_scene->setPlanner(m_planner);
     m_graphicsView->setScene(m_scene);
     m_graphicsView->setRenderHint(QPainter::Antialiasing);
     m_graphicsView->setDragMode(QGraphicsView::RubberBandDrag);
@@ -63,13 +82,26 @@ void MainWindow::setupUI() {
     m_generateButton = new QPushButton("Генерировать");
     m_findPathButton = new QPushButton("Найти путь");
 
+    m_diagonalCheckBox = new QCheckBox("Диагональные шаги");
+    m_weightedCheckBox = new QCheckBox("Диагональ дороже (√2)");
+    m_weightedCheckBox->setEnabled(false);
+
+    m_agentsSpinBox = new QSpinBox();
+    m_agentsSpinBox->setMinimum(MIN_AGENTS_cnt);
+    m_agentsSpinBox->setMaximum(MAX_AGENTS_cnt);
+    m_agentsSpinBox->setValue(DEFAULT_AGENTS_cnt);
+    m_agentsButton = new QPushButton("Запустить агентов");
+
     m_instructionsLabel = new QLabel(
         "Установка точек (ЛКМ):\n"
         "• Первый клик - точка А (зеленая)\n"
         "• Второй клик - точка Б (красная)\n"
         "• Третий клик - сброс и новая точка А\n"
         "• И так далее...\n\n"
-        "Ctrl + Колесо - масштабирование"
+        "ПКМ (с протяжкой) - стены\n"
+        "Ctrl + ПКМ - стирание стен\n"
+        "Ctrl + Колесо - масштабирование\n"
+        "ЛКМ по миникарте - переход"
         );
     m_instructionsLabel->setAlignment(Qt::AlignCenter);
     m_instructionsLabel->setWordWrap(true);
@@ -89,6 +121,15 @@ void MainWindow::setupUI() {
     mainLayout->addLayout(sizeLayout2);
     mainLayout->addWidget(m_generateButton);
     mainLayout->addWidget(m_findPathButton);
+    mainLayout->addWidget(m_diagonalCheckBox);
+    mainLayout->addWidget(m_weightedCheckBox);
+
+    QHBoxLayout *agentsLayout = new QHBoxLayout();
+    agentsLayout->addWidget(new QLabel("Агенты:"));
+    agentsLayout->addWidget(m_agentsSpinBox);
+
+    mainLayout->addLayout(agentsLayout);
+    mainLayout->addWidget(m_agentsButton);
     mainLayout->addWidget(m_instructionsLabel);
     mainLayout->addStretch();
 
@@ -97,6 +138,15 @@ void MainWindow::setupUI() {
     controlDock->setFixedWidth(DOCK_WIDTH);
     controlDock->setFeatures(QDockWidget::NoDockWidgetFeatures);
     addDockWidget(Qt::LeftDockWidgetArea, controlDock);
+
+    m_minimap = new MinimapWidget(m_model, m_graphicsView);
+
+    QDockWidget *minimapDock = new QDockWidget(tr("Миникарта"), this);
+    minimapDock->setWidget(m_minimap);
+    minimapDock->setFixedWidth(DOCK_WIDTH);
+    minimapDock->setFeatures(QDockWidget::NoDockWidgetFeatures);
+    addDockWidget(Qt::LeftDockWidgetArea, minimapDock);
+    splitDockWidget(controlDock, minimapDock, Qt::Vertical);
 }
 
 void MainWindow::setupConnections() {
@@ -108,6 +158,20 @@ void MainWindow::setupConnections() {
                           &MainWindow::onCalculationFinished);
     connect(m_pathFinder, &PathFinder::pathNotFound, this,
                           &MainWindow::onPathNotFound);
+    connect(m_diagonalCheckBox, &QCheckBox::toggled, this,
+                                &MainWindow::onSearchModeChanged);
+    connect(m_weightedCheckBox, &QCheckBox::toggled, this,
+                                &MainWindow::onSearchModeChanged);
+
+    m_agentTimer.setInterval(AGENT_TICK_ms);
+    connect(&m_agentTimer, &QTimer::timeout, m_planner, &CooperativePlanner::tick);
+    connect(m_agentsButton, &QPushButton::clicked, this,
+                            &MainWindow::onAgentsClicked);
+
+#ifdef PATHFINDER_TRACING
+    QShortcut *dumpTrace = new QShortcut(QKeySequence(tr("Ctrl+Shift+T")), this);
+    connect(dumpTrace, &QShortcut::activated, this, &MainWindow::onDumpTraceTriggered);
+#endif
 }
 
 void MainWindow::onGenerateClicked() {
@@ -117,6 +181,7 @@ void MainWindow::onGenerateClicked() {
     int width = m_widthSpinBox->value();
     int height = m_heightSpinBox->value();
 
+    stopAgents();
     m_model->initialize(width, height);
 
     m_model->generateRandomWalls();
@@ -140,6 +205,7 @@ void MainWindow::onFindPathClicked() {
     }
     m_findPathButton->setEnabled(false);
 
+    TRACE_INSTANT("query", "findPathRequested");
     QMetaObject::invokeMethod(m_pathFinder, "findPath", Qt::QueuedConnection,
                               Q_ARG(QPoint, m_model->endPoint()),
                               Q_ARG(bool, false));
@@ -163,6 +229,88 @@ void MainWindow::onPathNotFound() {
                  ));
 }
 
+void MainWindow::onAgentsClicked() {
+    if (m_agentTimer.isActive()) {
+        stopAgents();
+        return;
+    }
+
+    if (m_model->width() == 0 || m_model->height() == 0) {
+        showError(tr("Пожалуйста, сначала создайте сетку (нажмите 'Генерировать')"));
+        return;
+    }
+
+    if (!m_planner->isSupported()) {
+        showError(tr("Карта %1×%2 слишком велика для кооперативного поиска агентов")
+                      .arg(m_model->width())
+                      .arg(m_model->height()));
+        return;
+    }
+
+    m_planner->clear();
+    m_planner->spawnRandomAgents(m_agentsSpinBox->value());
+
+    m_agentTimer.start();
+    m_agentsButton->setText(tr("Остановить агентов"));
+}
+
+void MainWindow::onSearchModeChanged() {
+    bool diagonal = m_diagonalCheckBox->isChecked();
+    m_weightedCheckBox->setEnabled(diagonal);
+
+    m_pathFinder->setConnectivity(diagonal ? PathFinder::Connectivity::Eight
+                                           : PathFinder::Connectivity::Four);
+    m_pathFinder->setCostModel(m_weightedCheckBox->isChecked() ? PathFinder::CostModel::Weighted
+                                                               : PathFinder::CostModel::Unit);
+    m_scene->clearPath();
+}
+
+#ifdef PATHFINDER_TRACING
+void MainWindow::onDumpTraceTriggered() {
+    QString path = QFileDialog::getSaveFileName(this, tr("Сохранить трассировку"),
+                                                "pathfinder-trace.json",
+                                                tr("Chrome trace (*.json)"));
+    if (path.isEmpty())
+        return;
+
+    if (!Tracing::dump(path))
+        showError(tr("Не удалось сохранить трассировку в %1").arg(path));
+}
+#endif
+
+void MainWindow::restoreSession() {
+    // Правка или новая карта до прихода снимка важнее него
+    const quint64 version = m_model->version();
+
+    QtConcurrent::run([directory = SessionSnapshot::defaultDirectory()]() {
+        SessionSnapshot snapshot;
+        snapshot.read(directory);
+        return snapshot;
+    }).then(this, [this, version](const SessionSnapshot &snapshot) {
+        if (snapshot.isEmpty() || m_model->version() != version)
+            return;
+
+        if (!snapshot.apply(m_model, m_pathFinder))
+            return;
+
+        if (m_model->width() <= MAX_SPINBOX_VAL && m_model->height() <= MAX_SPINBOX_VAL) {
+            m_widthSpinBox->setValue(m_model->width());
+            m_heightSpinBox->setValue(m_model->height());
+        }
+    });
+}
+
+void MainWindow::saveSession() {
+    if (m_model->width() > 0 && m_model->height() > 0 &&
+        !SessionSnapshot::save(SessionSnapshot::defaultDirectory(), m_model, m_pathFinder))
+        qWarning() << "MainWindow: не удалось сохранить сеанс";
+}
+
+void MainWindow::stopAgents() {
+    m_agentTimer.stop();
+    m_agentsButton->setText(tr("Запустить агентов"));
+}
+
 bool MainWindow::validateInput() {
     int width = m_widthSpinBox->value();
     int height = m_heightSpinBox->value();
@@ -200,6 +348,7 @@ void MainWindow::wheelEvent(QWheelEvent *event) {
 
 void MainWindow::closeEvent(QCloseEvent *event) {
     saveWindowState();
+    saveSession();
     QMainWindow::closeEvent(event);
 }
 
@@ -209,6 +358,8 @@ void MainWindow::saveWindowState() {
 
     m_settings.setValue("settings/width", m_widthSpinBox->value());
     m_settings.setValue("settings/height", m_heightSpinBox->value());
+    m_settings.setValue("settings/diagonal", m_diagonalCheckBox->isChecked());
+    m_settings.setValue("settings/weighted", m_weightedCheckBox->isChecked());
 }
 
 void MainWindow::restoreWindowState() {
@@ -225,4 +376,8 @@ void MainWindow::restoreWindowState() {
         m_widthSpinBox->setValue(m_settings.value("settings/width").toInt());
     if (m_settings.contains("settings/height"))
         m_heightSpinBox->setValue(m_settings.value("settings/height").toInt());
+    if (m_settings.contains("settings/diagonal"))
+        m_diagonalCheckBox->setChecked(m_settings.value("settings/diagonal").toBool());
+    if (m_settings.contains("settings/weighted"))
+        m_weightedCheckBox->setChecked(m_settings.value("settings/weighted").toBool());
 }
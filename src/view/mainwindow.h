@@ -3,10 +3,12 @@
 
 #include <QMainWindow>
 #include <QSettings>
+#include <QTimer>
 
 class QGraphicsView;
 class QSpinBox;
 class QPushButton;
+class QCheckBox;
 class QLabel;
 class QVBoxLayout;
 class QHBoxLayout;
@@ -14,7 +16,9 @@ class QWidget;
 class QDockWidget;
 class GridModel;
 class PathFinder;
+class CooperativePlanner;
 class GridScene;
+class MinimapWidget;
 class QSettings;
 
 class MainWindow : public QMainWindow {
@@ -34,6 +38,12 @@ class MainWindow : public QMainWindow {
     static constexpr int DEFAULT_SPINBOX_VAL = 20;
     static constexpr int MAX_SPINBOX_VAL = 100;
 
+    static constexpr int MIN_AGENTS_cnt = 1;
+    static constexpr int DEFAULT_AGENTS_cnt = 50;
+    static constexpr int MAX_AGENTS_cnt = 500;
+
+    static constexpr int AGENT_TICK_ms = 100;
+
 public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
@@ -47,6 +57,12 @@ private slots:
     void onFindPathClicked();
     void onCalculationFinished();
     void onPathNotFound();
+    void onAgentsClicked();
+    void onSearchModeChanged();
+    void restoreSession();
+#ifdef PATHFINDER_TRACING
+    void onDumpTraceTriggered();
+#endif
     void showError(const QString &message);
 
 private:
@@ -55,13 +71,21 @@ private:
     QSpinBox *m_heightSpinBox;
     QPushButton *m_generateButton;
     QPushButton *m_findPathButton;
+    QSpinBox *m_agentsSpinBox;
+    QPushButton *m_agentsButton;
+    QCheckBox *m_diagonalCheckBox;
+    QCheckBox *m_weightedCheckBox;
     QLabel *m_instructionsLabel;
     QLabel *m_widthLabel;
     QLabel *m_heightLabel;
 
     GridModel *m_model;
     PathFinder *m_pathFinder;
+    CooperativePlanner *m_planner;
     GridScene *m_scene;
+    MinimapWidget *m_minimap;
+
+    QTimer m_agentTimer;
 
     QDockWidget *m_controlDock;
 
@@ -70,8 +94,10 @@ private:
     void setupUI();
     void setupConnections();
     void saveWindowState();
+    void saveSession();
     void restoreWindowState();
     bool validateInput();
+    void stopAgents();
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,223 @@
+#include <QGraphicsView>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <vector>
+
+#include "../model/tracing.h"
+
+#include "minimapwidget.h"
+
+MinimapWidget::MinimapWidget(GridModel *model, QGraphicsView *view, QWidget *parent)
+    : QWidget(parent), m_model(model), m_view(view) {
+
+    setMinimumSize(MIN_SIZE_px, MIN_SIZE_px);
+    setCursor(Qt::PointingHandCursor);
+
+    connect(m_model, &GridModel::gridChanged, this, &MinimapWidget::onGridChanged);
+    connect(m_model, &GridModel::cellsChanged, this, &MinimapWidget::onCellsChanged);
+    connect(m_model, &GridModel::startPointChanged, this, qOverload<>(&QWidget::update));
+    connect(m_model, &GridModel::endPointChanged, this, qOverload<>(&QWidget::update));
+
+    // Рамка следует за прокруткой и масштабом (масштаб меняет диапазоны)
+    for (QScrollBar *bar : { m_view->horizontalScrollBar(), m_view->verticalScrollBar() }) {
+        connect(bar, &QScrollBar::valueChanged, this, qOverload<>(&QWidget::update));
+        connect(bar, &QScrollBar::rangeChanged, this, qOverload<>(&QWidget::update));
+    }
+
+    onGridChanged();
+}
+
+QSize MinimapWidget::sizeHint() const {
+    return QSize(MAX_IMAGE_px, MAX_IMAGE_px);
+}
+
+void MinimapWidget::onGridChanged() {
+    TRACE_SPAN("minimap", "onGridChanged");
+
+    ++m_generation;
+    m_rendering = false;
+    m_dirtyBlocks = QRect();
+
+    const int width = m_model->width();
+    const int height = m_model->height();
+    if (width <= 0 || height <= 0) {
+        m_image = QImage();
+        update();
+        return;
+    }
+
+    m_step = (std::max(width, height) + MAX_IMAGE_px - 1) / MAX_IMAGE_px;
+    m_image = QImage((width + m_step - 1) / m_step, (height + m_step - 1) / m_step,
+                     QImage::Format_Grayscale8);
+    m_image.fill(255);
+    m_rendering = true;
+    update();
+
+    // Изображение целиком читает всю карту - считаем его вне потока GUI.
+    // Курсор берется здесь: он привязан к только что смененной карте
+    QtConcurrent::run([grid = m_model->cursor(), image = m_image, width, height,
+                       step = m_step]() mutable {
+        TRACE_SPAN("minimap", "render");
+        renderBlocks(image, grid, width, height, step, image.rect());
+        return image;
+    }).then(this, [this, generation = m_generation](QImage image) {
+        if (generation != m_generation)
+            return;
+
+        m_image = std::move(image);
+        m_rendering = false;
+
+        // Правки во время расчета: курсор мог их и не увидеть
+        if (!m_dirtyBlocks.isEmpty()) {
+            renderBlocks(m_dirtyBlocks);
+            m_dirtyBlocks = QRect();
+        }
+        update();
+    });
+}
+
+void MinimapWidget::onCellsChanged(const GridDelta &delta) {
+    TRACE_SPAN("minimap", "onCellsChanged");
+
+    if (m_image.isNull() || delta.region.isEmpty())
+        return;
+
+    QRect blocks(QPoint(delta.region.left() / m_step, delta.region.top() / m_step),
+                 QPoint(delta.region.right() / m_step, delta.region.bottom() / m_step));
+    blocks = blocks.intersected(m_image.rect());
+    if (blocks.isEmpty())
+        return;
+
+    if (m_rendering) {
+        m_dirtyBlocks = m_dirtyBlocks.united(blocks);
+        return;
+    }
+
+    renderBlocks(blocks);
+    update();
+}
+
+void MinimapWidget::renderBlocks(const QRect &blocks) {
+    ChunkedGrid::Cursor grid = m_model->cursor();
+    renderBlocks(m_image, grid, m_model->width(), m_model->height(), m_step, blocks);
+}
+
+void MinimapWidget::renderBlocks(QImage &image, ChunkedGrid::Cursor &grid, int width, int height,
+                                 int step, const QRect &blocks) {
+    const int x0 = blocks.left() * step;
+    const int x1 = std::min((blocks.right() + 1) * step, width);
+
+    std::vector<int> walls(blocks.width());
+
+    // Клетки читаются построчно, счетчики стен - по столбцам блоков
+    for (int by = blocks.top(); by <= blocks.bottom(); ++by) {
+        std::fill(walls.begin(), walls.end(), 0);
+
+        const int y0 = by * step;
+        const int y1 = std::min(y0 + step, height);
+
+        for (int y = y0; y < y1; ++y) {
+            for (int x = x0; x < x1; ++x) {
+                if (grid.cell(x, y) == CellType::Wall)
+                    ++walls[x / step - blocks.left()];
+            }
+        }
+
+        uchar *line = image.scanLine(by);
+        for (int bx = blocks.left(); bx <= blocks.right(); ++bx) {
+            const int columns = std::min((bx + 1) * step, width) - bx * step;
+            const int cells = columns * (y1 - y0);
+            // Свободный блок белый, сплошная стена - серая, как на сцене
+            line[bx] = static_cast<uchar>(255 - walls[bx - blocks.left()] * 127 / cells);
+        }
+    }
+}
+
+QRectF MinimapWidget::imageRect() const {
+    if (m_image.isNull())
+        return QRectF();
+
+    QSizeF size = QSizeF(m_model->width(), m_model->height())
+                      .scaled(QSizeF(this->size()), Qt::KeepAspectRatio);
+    return QRectF(QPointF((width() - size.width()) / 2, (height() - size.height()) / 2), size);
+}
+
+QPointF MinimapWidget::gridToWidget(const QPointF &cell) const {
+    QRectF target = imageRect();
+    return QPointF(target.left() + cell.x() * target.width() / m_model->width(),
+                   target.top() + cell.y() * target.height() / m_model->height());
+}
+
+void MinimapWidget::paintEvent(QPaintEvent *event) {
+    Q_UNUSED(event);
+
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().window());
+
+    if (m_image.isNull())
+        return;
+
+    QRectF target = imageRect();
+    // Последний блок может быть неполным: берется только его занятая часть
+    QRectF source(0, 0, double(m_model->width()) / m_step, double(m_model->height()) / m_step);
+    painter.drawImage(target, m_image, source);
+
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    auto drawMarker = [&](const QPoint &point, const QColor &color) {
+        if (!m_model->isValidPoint(point))
+            return;
+        painter.setPen(QPen(Qt::black, 1));
+        painter.setBrush(color);
+        painter.drawEllipse(gridToWidget(QPointF(point) + QPointF(0.5, 0.5)),
+                            MARKER_px / 2.0, MARKER_px / 2.0);
+    };
+    drawMarker(m_model->startPoint(), Qt::green);
+    drawMarker(m_model->endPoint(), Qt::red);
+
+    // Видимая область вида в долях сцены; сцена совпадает с сеткой
+    QRectF scene = m_view->sceneRect();
+    if (scene.isEmpty())
+        return;
+
+    QRectF visible = m_view->mapToScene(m_view->viewport()->rect()).boundingRect()
+                         .intersected(scene);
+    QRectF frame(QPointF(target.left() + (visible.left() - scene.left()) / scene.width() * target.width(),
+                         target.top() + (visible.top() - scene.top()) / scene.height() * target.height()),
+                 QSizeF(visible.width() / scene.width() * target.width(),
+                        visible.height() / scene.height() * target.height()));
+
+    painter.setPen(QPen(Qt::blue, 2));
+    painter.setBrush(Qt::NoBrush);
+    painter.drawRect(frame);
+}
+
+void MinimapWidget::mousePressEvent(QMouseEvent *event) {
+    if (event->button() == Qt::LeftButton)
+        jumpTo(event->position());
+    else
+        QWidget::mousePressEvent(event);
+}
+
+void MinimapWidget::mouseMoveEvent(QMouseEvent *event) {
+    if (event->buttons() & Qt::LeftButton)
+        jumpTo(event->position());
+    else
+        QWidget::mouseMoveEvent(event);
+}
+
+void MinimapWidget::jumpTo(const QPointF &position) {
+    QRectF target = imageRect();
+    QRectF scene = m_view->sceneRect();
+    if (target.isEmpty() || scene.isEmpty())
+        return;
+
+    qreal fx = std::clamp((position.x() - target.left()) / target.width(), 0.0, 1.0);
+    qreal fy = std::clamp((position.y() - target.top()) / target.height(), 0.0, 1.0);
+
+    m_view->centerOn(scene.left() + fx * scene.width(), scene.top() + fy * scene.height());
+}
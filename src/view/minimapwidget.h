@@ -0,0 +1,66 @@
+#ifndef MINIMAPWIDGET_H
+#define MINIMAPWIDGET_H
+
+#include <QImage>
+#include <QWidget>
+
+#include "../model/gridmodel.h"
+
+class QGraphicsView;
+
+// Обзорная карта: уменьшенное изображение сетки, пиксель - блок клеток,
+// яркость - доля стен в блоке. Правки клеток пересчитывают только свои
+// блоки, новая карта - все изображение, в пуле потоков: до его готовности
+// виден пустой макет, правки за это время досчитываются после. Поверх
+// рисуются точки А/Б и рамка видимой области; клик или протяжка ЛКМ
+// центрирует на точке основной вид.
+// Сцена при этом не перерисовывается, меняется только прокрутка вида.
+class MinimapWidget final : public QWidget {
+    Q_OBJECT
+
+    // Наибольшая сторона изображения; крупная карта прореживается блоками
+    static constexpr int MAX_IMAGE_px = 256;
+    static constexpr int MIN_SIZE_px = 120;
+    static constexpr int MARKER_px = 6;
+
+public:
+    MinimapWidget(GridModel *model, QGraphicsView *view, QWidget *parent = nullptr);
+
+    QSize sizeHint() const override;
+
+public slots:
+    void onGridChanged();
+    void onCellsChanged(const GridDelta &delta);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+
+private:
+    GridModel *m_model;
+    QGraphicsView *m_view;
+
+    QImage m_image;
+    // Сторона блока в клетках
+    int m_step = 1;
+
+    // Поколение карты: изображение прежней карты, досчитанное в пуле,
+    // отбрасывается
+    quint64 m_generation = 0;
+    bool m_rendering = false;
+    // Блоки правок, пришедших во время фонового расчета
+    QRect m_dirtyBlocks;
+
+    // Пересчет пикселей блоков; blocks - в координатах изображения
+    void renderBlocks(const QRect &blocks);
+    static void renderBlocks(QImage &image, ChunkedGrid::Cursor &grid, int width, int height,
+                             int step, const QRect &blocks);
+
+    // Где изображение лежит в виджете, с сохранением пропорций
+    QRectF imageRect() const;
+    QPointF gridToWidget(const QPointF &cell) const;
+    void jumpTo(const QPointF &position);
+};
+
+#endif // MINIMAPWIDGET_H
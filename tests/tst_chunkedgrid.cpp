@@ -0,0 +1,179 @@
+#include <QtTest>
+
+#include <QTemporaryDir>
+
+#include "chunkedgrid.h"
+
+namespace {
+
+// Не кратны размеру блока: крайние блоки неполные
+constexpr int WIDTH_cnt = ChunkedGrid::CHUNK_SIZE * 3 + 17;
+constexpr int HEIGHT_cnt = ChunkedGrid::CHUNK_SIZE * 2 + 5;
+constexpr int MAX_SIDE_cnt = 16384;
+
+CellType pattern(int x, int y, int seed) {
+    return (x * 7 + y * 13 + seed) % 5 == 0 ? CellType::Wall : CellType::Empty;
+}
+
+// Блок (1, 1) однородный - в каталоге одним значением
+void fill(ChunkedGrid &grid, int seed) {
+    for (int y = 0; y < grid.height(); ++y) {
+        for (int x = 0; x < grid.width(); ++x)
+            grid.setCell(x, y, pattern(x, y, seed));
+    }
+    grid.storeChunk(1, 1, ChunkedGrid::ChunkData(ChunkedGrid::CHUNK_CELLS,
+                                                 static_cast<uint8_t>(CellType::Wall)));
+}
+
+CellType expected(int x, int y, int seed) {
+    if (x >> ChunkedGrid::CHUNK_SHIFT == 1 && y >> ChunkedGrid::CHUNK_SHIFT == 1)
+        return CellType::Wall;
+    return pattern(x, y, seed);
+}
+
+// Первая расходящаяся клетка или (-1, -1)
+QPoint firstMismatch(const ChunkedGrid &grid, int seed) {
+    for (int y = 0; y < grid.height(); ++y) {
+        for (int x = 0; x < grid.width(); ++x) {
+            if (grid.cell(x, y) != expected(x, y, seed))
+                return QPoint(x, y);
+        }
+    }
+    return QPoint(-1, -1);
+}
+
+QPoint firstCursorMismatch(const ChunkedGrid &grid, int seed) {
+    ChunkedGrid::Cursor cursor(grid);
+    for (int y = 0; y < cursor.height(); ++y) {
+        for (int x = 0; x < cursor.width(); ++x) {
+            if (cursor.cell(x, y) != expected(x, y, seed))
+                return QPoint(x, y);
+        }
+    }
+    return QPoint(-1, -1);
+}
+
+} // namespace
+
+class TestChunkedGrid final : public QObject {
+    Q_OBJECT
+
+private slots:
+    void pageOutAndIn();
+    void cursorOutsideMapReadsWalls();
+    void saveAndOpen();
+    void saveOverOpenedWorld();
+    void openRejectsMissingFile();
+};
+
+void TestChunkedGrid::pageOutAndIn() {
+    ChunkedGrid grid;
+    grid.reset(WIDTH_cnt, HEIGHT_cnt);
+    grid.setResidentLimit(2);
+    fill(grid, 0);
+
+    // Измененные блоки ушли в подкачку, в памяти не больше предела
+    QVERIFY(grid.residentChunks() <= 2);
+    QCOMPARE(firstMismatch(grid, 0), QPoint(-1, -1));
+    QVERIFY(grid.residentChunks() <= 2);
+    QCOMPARE(firstCursorMismatch(grid, 0), QPoint(-1, -1));
+
+    // Правка выгруженного блока поднимает его из подкачки целиком
+    grid.setCell(0, 0, CellType::Wall);
+    QCOMPARE(grid.cell(0, 0), CellType::Wall);
+    QCOMPARE(grid.cell(1, 0), expected(1, 0, 0));
+}
+
+void TestChunkedGrid::cursorOutsideMapReadsWalls() {
+    ChunkedGrid grid;
+    grid.reset(10, 10);
+
+    ChunkedGrid::Cursor cursor(grid);
+    QCOMPARE(cursor.cell(-1, 0), CellType::Wall);
+    QCOMPARE(cursor.cell(10, 0), CellType::Wall);
+    QCOMPARE(cursor.cell(0, 10), CellType::Wall);
+    QCOMPARE(cursor.cell(9, 9), CellType::Empty);
+
+    // Курсор старой карты после reset читает одни стены, а уже
+    // закрепленные им блоки - как до reset
+    ChunkedGrid::Cursor stale(grid);
+    grid.reset(20, 20);
+    QCOMPARE(stale.cell(0, 0), CellType::Wall);
+    QCOMPARE(stale.width(), 10);
+    QCOMPARE(cursor.cell(0, 0), CellType::Empty);
+}
+
+void TestChunkedGrid::saveAndOpen() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath("world.pfw");
+
+    ChunkedGrid grid;
+    grid.reset(WIDTH_cnt, HEIGHT_cnt);
+    grid.setResidentLimit(2);
+    fill(grid, 1);
+    QCOMPARE(grid.stamp(), quint64(0));
+
+    QVERIFY(grid.save(path));
+    QVERIFY(grid.stamp() != 0);
+    // Выгруженные блоки теперь читаются из сохраненного файла
+    QCOMPARE(firstMismatch(grid, 1), QPoint(-1, -1));
+
+    ChunkedGrid opened;
+    opened.setResidentLimit(1);
+    QVERIFY(opened.open(path, MAX_SIDE_cnt, MAX_SIDE_cnt));
+    QCOMPARE(opened.width(), WIDTH_cnt);
+    QCOMPARE(opened.height(), HEIGHT_cnt);
+    QCOMPARE(opened.stamp(), grid.stamp());
+    QCOMPARE(firstMismatch(opened, 1), QPoint(-1, -1));
+    QCOMPARE(firstCursorMismatch(opened, 1), QPoint(-1, -1));
+    QVERIFY(opened.residentChunks() <= 1);
+
+    // Мир больше допустимого не подключается
+    ChunkedGrid small;
+    QVERIFY(!small.open(path, WIDTH_cnt - 1, HEIGHT_cnt));
+}
+
+void TestChunkedGrid::saveOverOpenedWorld() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath("world.pfw");
+
+    ChunkedGrid grid;
+    grid.reset(WIDTH_cnt, HEIGHT_cnt);
+    fill(grid, 2);
+    QVERIFY(grid.save(path));
+
+    // Правки поверх подключенного мира, часть блоков - в подкачке
+    ChunkedGrid opened;
+    opened.setResidentLimit(1);
+    QVERIFY(opened.open(path, MAX_SIDE_cnt, MAX_SIDE_cnt));
+    const quint64 firstStamp = opened.stamp();
+    fill(opened, 3);
+
+    // Новый файл подменяет тот, из которого читаются блоки
+    QVERIFY(opened.save(path));
+    QVERIFY(opened.stamp() != firstStamp);
+    QCOMPARE(firstMismatch(opened, 3), QPoint(-1, -1));
+
+    ChunkedGrid reopened;
+    QVERIFY(reopened.open(path, MAX_SIDE_cnt, MAX_SIDE_cnt));
+    QCOMPARE(reopened.stamp(), opened.stamp());
+    QCOMPARE(firstMismatch(reopened, 3), QPoint(-1, -1));
+}
+
+void TestChunkedGrid::openRejectsMissingFile() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    ChunkedGrid grid;
+    grid.reset(4, 4);
+    QVERIFY(!grid.open(dir.filePath("missing.pfw"), MAX_SIDE_cnt, MAX_SIDE_cnt));
+    // Неудачное открытие не трогает текущую карту
+    QCOMPARE(grid.width(), 4);
+    QCOMPARE(grid.stamp(), quint64(0));
+}
+
+QTEST_GUILESS_MAIN(TestChunkedGrid)
+
+#include "tst_chunkedgrid.moc"
@@ -0,0 +1,109 @@
+#include <QtTest>
+
+#include "compactpath.h"
+
+class TestCompactPath final : public QObject {
+    Q_OBJECT
+
+private slots:
+    void singleCellIsEmpty();
+    void appendRunsRoundTrip();
+    void appendMergesSameDirection();
+    void longRunIsSplit();
+    void runsConstructorRoundTrip();
+    void containsCellsOfDiagonalRun();
+};
+
+void TestCompactPath::singleCellIsEmpty() {
+    CompactPath path(QPoint(3, 4));
+
+    QVERIFY(path.isEmpty());
+    QCOMPARE(path.size(), size_t(1));
+    QCOMPARE(path.runCount(), size_t(0));
+    QCOMPARE(path.start(), QPoint(3, 4));
+    QCOMPARE(path.end(), QPoint(3, 4));
+    QCOMPARE(path.toPoints(), std::vector<QPoint>{ QPoint(3, 4) });
+}
+
+void TestCompactPath::appendRunsRoundTrip() {
+    CompactPath path(QPoint(1, 1));
+    path.appendRun(Direction::RIGHT, 3);
+    path.appendRun(Direction::DOWN, 2);
+    path.appendRun(Direction::UP_LEFT, 1);
+
+    const std::vector<QPoint> expected = {
+        QPoint(1, 1), QPoint(2, 1), QPoint(3, 1), QPoint(4, 1),
+        QPoint(4, 2), QPoint(4, 3), QPoint(3, 2)
+    };
+
+    QVERIFY(!path.isEmpty());
+    QCOMPARE(path.size(), expected.size());
+    QCOMPARE(path.runCount(), size_t(3));
+    QCOMPARE(path.end(), QPoint(3, 2));
+    QCOMPARE(path.toPoints(), expected);
+}
+
+void TestCompactPath::appendMergesSameDirection() {
+    CompactPath path(QPoint(0, 0));
+    path.appendRun(Direction::RIGHT, 2);
+    path.appendRun(Direction::RIGHT, 5);
+
+    QCOMPARE(path.runCount(), size_t(1));
+    QCOMPARE(CompactPath::runDirection(path.runs().front()), Direction::RIGHT);
+    QCOMPARE(CompactPath::runLength(path.runs().front()), uint32_t(7));
+    QCOMPARE(path.end(), QPoint(7, 0));
+}
+
+void TestCompactPath::longRunIsSplit() {
+    // Путь не распаковывается: клеток в нем больше полумиллиарда
+    const uint32_t extra = 5;
+    CompactPath path(QPoint(0, 0));
+    path.appendRun(Direction::RIGHT, CompactPath::MAX_RUN_LENGTH + extra);
+
+    QCOMPARE(path.runCount(), size_t(2));
+    QCOMPARE(CompactPath::runLength(path.runs()[0]), CompactPath::MAX_RUN_LENGTH);
+    QCOMPARE(CompactPath::runLength(path.runs()[1]), extra);
+    QCOMPARE(CompactPath::runDirection(path.runs()[1]), Direction::RIGHT);
+    QCOMPARE(path.size(), size_t(CompactPath::MAX_RUN_LENGTH) + extra + 1);
+    QCOMPARE(path.end(), QPoint(static_cast<int>(CompactPath::MAX_RUN_LENGTH + extra), 0));
+
+    // Продление заполненной серии тоже начинает новую
+    CompactPath full(QPoint(0, 0));
+    full.appendRun(Direction::DOWN, CompactPath::MAX_RUN_LENGTH);
+    full.appendRun(Direction::DOWN, 1);
+    QCOMPARE(full.runCount(), size_t(2));
+    QCOMPARE(full.end(), QPoint(0, static_cast<int>(CompactPath::MAX_RUN_LENGTH) + 1));
+}
+
+void TestCompactPath::runsConstructorRoundTrip() {
+    CompactPath built(QPoint(5, 5));
+    built.appendRun(Direction::LEFT, 4);
+    built.appendRun(Direction::DOWN_RIGHT, 2);
+    built.appendRun(Direction::UP, 1);
+
+    CompactPath restored(built.start(), built.runs());
+
+    QCOMPARE(restored.start(), built.start());
+    QCOMPARE(restored.end(), built.end());
+    QCOMPARE(restored.size(), built.size());
+    QCOMPARE(restored.runs(), built.runs());
+    QCOMPARE(restored.toPoints(), built.toPoints());
+}
+
+void TestCompactPath::containsCellsOfDiagonalRun() {
+    CompactPath path(QPoint(2, 2));
+    path.appendRun(Direction::DOWN_RIGHT, 3);
+    path.appendRun(Direction::LEFT, 2);
+
+    for (const QPoint &point : path.toPoints())
+        QVERIFY(path.contains(point));
+
+    QVERIFY(!path.contains(QPoint(3, 2)));
+    QVERIFY(!path.contains(QPoint(6, 6)));
+    QVERIFY(!path.contains(QPoint(1, 1)));
+    QVERIFY(!path.contains(QPoint(2, 5)));
+}
+
+QTEST_GUILESS_MAIN(TestCompactPath)
+
+#include "tst_compactpath.moc"
@@ -0,0 +1,152 @@
+#include <QtTest>
+
+#include <QSignalSpy>
+
+#include <algorithm>
+
+#include "gridmodel.h"
+
+namespace {
+
+std::vector<QPoint> sorted(std::vector<QPoint> points) {
+    std::sort(points.begin(), points.end(), [](const QPoint &a, const QPoint &b) {
+        return a.y() != b.y() ? a.y() < b.y() : a.x() < b.x();
+    });
+    return points;
+}
+
+GridDelta deltaAt(const QSignalSpy &spy, int index) {
+    return spy.at(index).at(0).value<GridDelta>();
+}
+
+} // namespace
+
+class TestGridModel final : public QObject {
+    Q_OBJECT
+
+private slots:
+    void singleEditIsOwnTransaction();
+    void transactionPublishesOnce();
+    void nestedTransactionsPublishOnOuterCommit();
+    void deltaReportsNetChanges();
+    void initializeDiscardsOpenEdit();
+};
+
+void TestGridModel::singleEditIsOwnTransaction() {
+    GridModel model;
+    model.initialize(4, 4);
+    QSignalSpy spy(&model, &GridModel::cellsChanged);
+    const quint64 version = model.version();
+
+    model.setCell(1, 2, CellType::Wall);
+    model.setCell(1, 2, CellType::Wall);
+
+    // Повторная запись того же значения - не правка
+    QCOMPARE(spy.count(), 1);
+    const GridDelta delta = deltaAt(spy, 0);
+    QCOMPARE(delta.closed, std::vector<QPoint>{ QPoint(1, 2) });
+    QVERIFY(delta.opened.empty());
+    QCOMPARE(delta.region, QRect(1, 2, 1, 1));
+    QCOMPARE(delta.version, version + 1);
+    QCOMPARE(model.version(), version + 1);
+}
+
+void TestGridModel::transactionPublishesOnce() {
+    GridModel model;
+    model.initialize(8, 8);
+    QSignalSpy spy(&model, &GridModel::cellsChanged);
+    const quint64 version = model.version();
+
+    {
+        GridEditTransaction transaction(&model);
+        model.setCell(1, 1, CellType::Wall);
+        model.setCell(5, 3, CellType::Wall);
+        model.setCell(2, 6, CellType::Wall);
+        QCOMPARE(spy.count(), 0);
+        QCOMPARE(model.version(), version);
+    }
+
+    QCOMPARE(spy.count(), 1);
+    const GridDelta delta = deltaAt(spy, 0);
+    QCOMPARE(sorted(delta.closed),
+             (std::vector<QPoint>{ QPoint(1, 1), QPoint(5, 3), QPoint(2, 6) }));
+    QVERIFY(delta.opened.empty());
+    QCOMPARE(delta.region, QRect(QPoint(1, 1), QPoint(5, 6)));
+    QCOMPARE(delta.version, version + 1);
+}
+
+void TestGridModel::nestedTransactionsPublishOnOuterCommit() {
+    GridModel model;
+    model.initialize(4, 4);
+    QSignalSpy spy(&model, &GridModel::cellsChanged);
+
+    model.beginEdit();
+    model.setCell(0, 0, CellType::Wall);
+    {
+        GridEditTransaction inner(&model);
+        model.setCell(3, 3, CellType::Wall);
+    }
+    QCOMPARE(spy.count(), 0);
+    model.commitEdit();
+
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(sorted(deltaAt(spy, 0).closed),
+             (std::vector<QPoint>{ QPoint(0, 0), QPoint(3, 3) }));
+
+    // Лишний commitEdit ничего не публикует
+    model.commitEdit();
+    QCOMPARE(spy.count(), 1);
+}
+
+void TestGridModel::deltaReportsNetChanges() {
+    GridModel model;
+    model.initialize(8, 8);
+    model.setCell(3, 3, CellType::Wall);
+    model.setCell(6, 6, CellType::Wall);
+
+    QSignalSpy spy(&model, &GridModel::cellsChanged);
+    const quint64 version = model.version();
+
+    {
+        GridEditTransaction transaction(&model);
+        // Переключенные туда и обратно клетки в итог не попадают
+        model.setCell(3, 3, CellType::Empty);
+        model.setCell(3, 3, CellType::Wall);
+        model.setCell(4, 4, CellType::Wall);
+        model.setCell(4, 4, CellType::Empty);
+
+        model.setCell(5, 5, CellType::Wall);
+        model.setCell(6, 6, CellType::Empty);
+        // Смена типа без смены проходимости - только в области правки
+        model.setCell(7, 7, CellType::Path);
+    }
+
+    QCOMPARE(spy.count(), 1);
+    const GridDelta delta = deltaAt(spy, 0);
+    QCOMPARE(delta.closed, std::vector<QPoint>{ QPoint(5, 5) });
+    QCOMPARE(delta.opened, std::vector<QPoint>{ QPoint(6, 6) });
+    QCOMPARE(delta.region, QRect(QPoint(3, 3), QPoint(7, 7)));
+    QCOMPARE(delta.version, version + 1);
+    QCOMPARE(model.getCell(7, 7), CellType::Path);
+}
+
+void TestGridModel::initializeDiscardsOpenEdit() {
+    GridModel model;
+    model.initialize(4, 4);
+    QSignalSpy spy(&model, &GridModel::cellsChanged);
+    QSignalSpy layoutSpy(&model, &GridModel::layoutChanged);
+
+    model.beginEdit();
+    model.setCell(1, 1, CellType::Wall);
+    model.initialize(6, 6);
+    model.commitEdit();
+
+    // Правка относилась к старой карте и не публикуется
+    QCOMPARE(layoutSpy.count(), 1);
+    QCOMPARE(spy.count(), 0);
+    QVERIFY(model.isWalkable(1, 1));
+}
+
+QTEST_GUILESS_MAIN(TestGridModel)
+
+#include "tst_gridmodel.moc"
@@ -0,0 +1,99 @@
+#include <QtTest>
+
+#include <QBuffer>
+
+#include "chunkedgrid.h"
+#include "landmarktable.h"
+#include "paddedmask.h"
+
+namespace {
+
+constexpr int WIDTH_cnt = 12;
+constexpr int HEIGHT_cnt = 9;
+constexpr int LANDMARK_cnt = 4;
+
+std::shared_ptr<LandmarkTable> buildTable() {
+    ChunkedGrid grid;
+    grid.reset(WIDTH_cnt, HEIGHT_cnt);
+    for (int y = 0; y < HEIGHT_cnt - 2; ++y)
+        grid.setCell(5, y, CellType::Wall);
+
+    ChunkedGrid::Cursor cells(grid);
+    PaddedMask mask(cells, WIDTH_cnt, HEIGHT_cnt);
+    return LandmarkTable::build(mask, LANDMARK_cnt, CancellationToken());
+}
+
+QByteArray serialize(const LandmarkTable &table) {
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    if (!table.save(&buffer))
+        return QByteArray();
+    return data;
+}
+
+std::shared_ptr<LandmarkTable> deserialize(QByteArray data) {
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::ReadOnly);
+    return LandmarkTable::load(&buffer);
+}
+
+} // namespace
+
+class TestLandmarkTable final : public QObject {
+    Q_OBJECT
+
+private slots:
+    void saveLoadRoundTrip();
+    void loadRejectsTruncatedInput();
+    void loadRejectsOversizedHeader();
+};
+
+void TestLandmarkTable::saveLoadRoundTrip() {
+    auto table = buildTable();
+    QVERIFY(table);
+    QCOMPARE(static_cast<int>(table->landmarks().size()), LANDMARK_cnt);
+
+    const QByteArray data = serialize(*table);
+    QVERIFY(!data.isEmpty());
+
+    auto loaded = deserialize(data);
+    QVERIFY(loaded);
+    QCOMPARE(loaded->width(), table->width());
+    QCOMPARE(loaded->height(), table->height());
+    QCOMPARE(loaded->landmarks(), table->landmarks());
+
+    const int cells = WIDTH_cnt * HEIGHT_cnt;
+    for (int from = 0; from < cells; ++from) {
+        for (int to = 0; to < cells; ++to)
+            QCOMPARE(loaded->heuristic(from, to), table->heuristic(from, to));
+    }
+}
+
+void TestLandmarkTable::loadRejectsTruncatedInput() {
+    auto table = buildTable();
+    QVERIFY(table);
+    const QByteArray data = serialize(*table);
+    QVERIFY(!data.isEmpty());
+
+    // Обрыв в любом месте - заголовок, ориентиры или расстояния
+    for (qsizetype size = 0; size < data.size(); ++size)
+        QVERIFY2(!deserialize(data.left(size)), qPrintable(QString::number(size)));
+}
+
+void TestLandmarkTable::loadRejectsOversizedHeader() {
+    auto table = buildTable();
+    QVERIFY(table);
+    QByteArray data = serialize(*table);
+    QVERIFY(!data.isEmpty());
+
+    // Заголовок обещает таблицу больше, чем есть в файле: память под нее
+    // не выделяется. Ширина - сразу после magic и версии (QDataStream, big-endian)
+    const int widthOffset = sizeof(quint32) + sizeof(quint16);
+    data[widthOffset + 2] = char(0x10);
+    QVERIFY(!deserialize(data));
+}
+
+QTEST_GUILESS_MAIN(TestLandmarkTable)
+
+#include "tst_landmarktable.moc"
@@ -0,0 +1,251 @@
+#include <QtTest>
+
+#include <QRandomGenerator>
+
+#include <limits>
+#include <queue>
+
+#include "gridmodel.h"
+#include "landmarktable.h"
+#include "paddedmask.h"
+#include "pathfinder.h"
+
+namespace {
+
+constexpr int MAP_cnt = 40;
+constexpr int QUERIES_cnt = 40;
+constexpr int WAIT_ms = 10000;
+constexpr quint64 UNREACHABLE = std::numeric_limits<quint64>::max();
+
+struct StepCost {
+    quint64 straight;
+    quint64 diagonal;
+};
+
+StepCost stepCost(PathFinder::Connectivity connectivity, PathFinder::CostModel costModel) {
+    // Те же веса, что у ядра поиска (OctileCost)
+    if (connectivity == PathFinder::Connectivity::Eight &&
+        costModel == PathFinder::CostModel::Weighted)
+        return { 5, 7 };
+    return { 1, 1 };
+}
+
+// Шаг по правилам поиска: диагональ не срезает угол стены
+bool canStep(const GridModel &model, int x, int y, int dir) {
+    const int nx = x + Direction::DX[dir];
+    const int ny = y + Direction::DY[dir];
+    if (!model.isWalkable(nx, ny))
+        return false;
+    if (!Direction::isDiagonal(dir))
+        return true;
+    return model.isWalkable(nx, y) && model.isWalkable(x, ny);
+}
+
+// Эталон - Дейкстра по клеткам модели; при единичных весах это обычный BFS
+std::vector<quint64> referenceCosts(const GridModel &model, const QPoint &start,
+                                    PathFinder::Connectivity connectivity, StepCost cost) {
+    const int width = model.width();
+    const int height = model.height();
+    const int directions = connectivity == PathFinder::Connectivity::Eight
+                               ? Direction::EXTENDED_COUNT
+                               : Direction::COUNT;
+
+    std::vector<quint64> costs(static_cast<size_t>(width) * height, UNREACHABLE);
+    using Entry = std::pair<quint64, int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+
+    costs[start.y() * width + start.x()] = 0;
+    queue.push({ 0, start.y() * width + start.x() });
+
+    while (!queue.empty()) {
+        const auto [current, index] = queue.top();
+        queue.pop();
+        if (current > costs[index])
+            continue;
+
+        const int x = index % width;
+        const int y = index / width;
+        for (int dir = 0; dir < directions; ++dir) {
+            if (!canStep(model, x, y, dir))
+                continue;
+            const int neighbor = (y + Direction::DY[dir]) * width + x + Direction::DX[dir];
+            const quint64 next = current +
+                (Direction::isDiagonal(dir) ? cost.diagonal : cost.straight);
+            if (next < costs[neighbor]) {
+                costs[neighbor] = next;
+                queue.push({ next, neighbor });
+            }
+        }
+    }
+    return costs;
+}
+
+// Стоимость пути с проверкой каждого шага; UNREACHABLE - путь недопустим
+quint64 walkCost(const GridModel &model, const CompactPath &path, StepCost cost) {
+    int x = path.start().x();
+    int y = path.start().y();
+    if (!model.isWalkable(x, y))
+        return UNREACHABLE;
+
+    quint64 total = 0;
+    for (uint32_t run : path.runs()) {
+        const uint8_t dir = CompactPath::runDirection(run);
+        for (uint32_t i = 0; i < CompactPath::runLength(run); ++i) {
+            if (!canStep(model, x, y, dir))
+                return UNREACHABLE;
+            x += Direction::DX[dir];
+            y += Direction::DY[dir];
+            total += Direction::isDiagonal(dir) ? cost.diagonal : cost.straight;
+        }
+    }
+    return total;
+}
+
+void fillRandomWalls(GridModel &model, QRandomGenerator &random, double wallProbability) {
+    GridEditTransaction transaction(&model);
+    for (int y = 0; y < model.height(); ++y) {
+        for (int x = 0; x < model.width(); ++x) {
+            if (random.generateDouble() < wallProbability)
+                model.setCell(x, y, CellType::Wall);
+        }
+    }
+}
+
+QPoint randomWalkable(const GridModel &model, QRandomGenerator &random) {
+    for (int attempt = 0; attempt < 64; ++attempt) {
+        QPoint point(random.bounded(model.width()), random.bounded(model.height()));
+        if (model.isWalkable(point.x(), point.y()))
+            return point;
+    }
+    return QPoint(-1, -1);
+}
+
+} // namespace
+
+class TestPathFinder final : public QObject {
+    Q_OBJECT
+
+private slots:
+    void optimalOnRandomMaps_data();
+    void optimalOnRandomMaps();
+    void landmarksSurviveOpenedCells();
+
+private:
+    // Сверка QUERIES_cnt случайных запросов с эталоном
+    void compareWithReference(GridModel &model, PathFinder &finder, QRandomGenerator &random,
+                              PathFinder::Connectivity connectivity,
+                              PathFinder::CostModel costModel);
+};
+
+void TestPathFinder::compareWithReference(GridModel &model, PathFinder &finder,
+                                          QRandomGenerator &random,
+                                          PathFinder::Connectivity connectivity,
+                                          PathFinder::CostModel costModel) {
+    const StepCost cost = stepCost(connectivity, costModel);
+
+    std::vector<PathFinder::PathQuery> queries;
+    for (int i = 0; i < QUERIES_cnt; ++i) {
+        QPoint start = randomWalkable(model, random);
+        QPoint end = randomWalkable(model, random);
+        if (start.x() >= 0 && end.x() >= 0)
+            queries.push_back({ start, end });
+    }
+    if (queries.empty())
+        return;
+
+    QFuture<PathPtr> future = finder.findPathsAsync(queries);
+    future.waitForFinished();
+    QCOMPARE(future.resultCount(), static_cast<int>(queries.size()));
+
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const PathFinder::PathQuery &query = queries[i];
+        const std::vector<quint64> costs = referenceCosts(model, query.start, connectivity, cost);
+        const quint64 expected = costs[query.end.y() * model.width() + query.end.x()];
+        const PathPtr path = future.resultAt(static_cast<int>(i));
+
+        if (expected == UNREACHABLE) {
+            QVERIFY2(!path, qPrintable(QString("path to unreachable (%1,%2)")
+                                           .arg(query.end.x()).arg(query.end.y())));
+            continue;
+        }
+
+        QVERIFY(path);
+        QCOMPARE(path->start(), query.start);
+        QCOMPARE(path->end(), query.end);
+        QCOMPARE(walkCost(model, *path, cost), expected);
+    }
+}
+
+void TestPathFinder::optimalOnRandomMaps_data() {
+    QTest::addColumn<PathFinder::Connectivity>("connectivity");
+    QTest::addColumn<PathFinder::CostModel>("costModel");
+    QTest::addColumn<bool>("landmarks");
+
+    QTest::newRow("bfs") << PathFinder::Connectivity::Four << PathFinder::CostModel::Unit << false;
+    QTest::newRow("alt") << PathFinder::Connectivity::Four << PathFinder::CostModel::Unit << true;
+    QTest::newRow("bfs-8") << PathFinder::Connectivity::Eight << PathFinder::CostModel::Unit
+                           << false;
+    QTest::newRow("astar-8-weighted") << PathFinder::Connectivity::Eight
+                                      << PathFinder::CostModel::Weighted << false;
+}
+
+void TestPathFinder::optimalOnRandomMaps() {
+    QFETCH(PathFinder::Connectivity, connectivity);
+    QFETCH(PathFinder::CostModel, costModel);
+    QFETCH(bool, landmarks);
+
+    QRandomGenerator random(26);
+
+    for (int map = 0; map < MAP_cnt; ++map) {
+        GridModel model;
+        PathFinder finder(&model);
+        finder.setConnectivity(connectivity);
+        finder.setCostModel(costModel);
+        // Без ориентиров таблица строится пустой и ALT не включается
+        finder.setLandmarkCount(landmarks ? 8 : 0);
+
+        model.initialize(1 + random.bounded(48), 1 + random.bounded(48));
+        fillRandomWalls(model, random, random.bounded(6) / 10.0);
+
+        // Таблица готова - готов и снимок карты, поиск идет по нему
+        QTRY_VERIFY_WITH_TIMEOUT(finder.landmarks(), WAIT_ms);
+
+        if (landmarks) {
+            // Фоновая таблица посчитана по пустой карте; эта - по стенам
+            ChunkedGrid::Cursor cells = model.cursor();
+            PaddedMask mask(cells, model.width(), model.height());
+            finder.setLandmarks(LandmarkTable::build(mask, 8, CancellationToken()));
+        }
+
+        compareWithReference(model, finder, random, connectivity, costModel);
+        if (QTest::currentTestFailed())
+            return;
+    }
+}
+
+void TestPathFinder::landmarksSurviveOpenedCells() {
+    QRandomGenerator random(29);
+
+    GridModel model;
+    PathFinder finder(&model);
+    model.initialize(40, 30);
+    fillRandomWalls(model, random, 0.45);
+    QTRY_VERIFY_WITH_TIMEOUT(finder.landmarks(), WAIT_ms);
+
+    // Открытые клетки укорачивают расстояния: таблицу пересчитывают,
+    // до готовности поиск идет без нее
+    {
+        GridEditTransaction transaction(&model);
+        for (int i = 0; i < 200; ++i)
+            model.setCell(random.bounded(40), random.bounded(30), CellType::Empty);
+    }
+    QTRY_VERIFY_WITH_TIMEOUT(finder.landmarks(), WAIT_ms);
+    QVERIFY(!finder.landmarks()->landmarks().empty());
+
+    compareWithReference(model, finder, random, PathFinder::Connectivity::Four,
+                         PathFinder::CostModel::Unit);
+}
+
+QTEST_GUILESS_MAIN(TestPathFinder)
+
+#include "tst_pathfinder.moc"
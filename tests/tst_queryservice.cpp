@@ -0,0 +1,212 @@
+#include <QtTest>
+
+#include <QCoreApplication>
+#include <QLocalSocket>
+#include <QtEndian>
+
+#include <memory>
+
+#include "gridmodel.h"
+#include "pathfinder.h"
+#include "queryservice.h"
+
+namespace {
+
+constexpr int WAIT_ms = 5000;
+constexpr int LENGTH_bytes = 4;
+constexpr int MAX_FRAME_bytes = 512;
+
+constexpr quint8 FIND_PATH = 1;
+constexpr quint8 MAP_INFO = 2;
+
+constexpr quint8 STATUS_OK = 0;
+constexpr quint8 STATUS_BAD_REQUEST = 2;
+
+template <typename T>
+void append(QByteArray &data, T value) {
+    char raw[sizeof(T)];
+    qToLittleEndian(value, raw);
+    data.append(raw, sizeof(T));
+}
+
+template <typename T>
+T read(const QByteArray &data, qsizetype offset) {
+    return qFromLittleEndian<T>(data.constData() + offset);
+}
+
+QByteArray frame(const QByteArray &body) {
+    QByteArray data;
+    append<quint32>(data, static_cast<quint32>(body.size()));
+    data.append(body);
+    return data;
+}
+
+QByteArray request(quint32 id, quint8 type, const QByteArray &payload = QByteArray()) {
+    QByteArray body;
+    append<quint32>(body, id);
+    append<quint8>(body, type);
+    body.append(payload);
+    return frame(body);
+}
+
+QByteArray findPathRequest(quint32 id, const QPoint &start, const QPoint &end) {
+    QByteArray points;
+    append<quint16>(points, static_cast<quint16>(start.x()));
+    append<quint16>(points, static_cast<quint16>(start.y()));
+    append<quint16>(points, static_cast<quint16>(end.x()));
+    append<quint16>(points, static_cast<quint16>(end.y()));
+    return request(id, FIND_PATH, points);
+}
+
+} // namespace
+
+class TestQueryService final : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void mapInfo();
+    void frameSplitAcrossWrites();
+    void pipelinedFrames();
+    void findPath();
+    void badFrameLengthClosesConnection_data();
+    void badFrameLengthClosesConnection();
+
+private:
+    std::unique_ptr<GridModel> m_model;
+    std::unique_ptr<PathFinder> m_pathFinder;
+    std::unique_ptr<QueryService> m_service;
+    std::unique_ptr<QLocalSocket> m_client;
+    QByteArray m_received;
+
+    // Тело следующего кадра ответа; пусто, если он не пришел
+    QByteArray nextFrame();
+};
+
+void TestQueryService::init() {
+    m_model = std::make_unique<GridModel>();
+    m_model->initialize(12, 5);
+    m_pathFinder = std::make_unique<PathFinder>(m_model.get());
+    m_service = std::make_unique<QueryService>(m_model.get(), m_pathFinder.get());
+
+    const QString name = QString("pathfinder-test-%1").arg(QCoreApplication::applicationPid());
+    QVERIFY(m_service->listen(name));
+
+    m_client = std::make_unique<QLocalSocket>();
+    m_client->connectToServer(m_service->fullServerName());
+    QTRY_COMPARE_WITH_TIMEOUT(m_client->state(), QLocalSocket::ConnectedState, WAIT_ms);
+    m_received.clear();
+}
+
+void TestQueryService::cleanup() {
+    m_client.reset();
+    m_service.reset();
+    m_pathFinder.reset();
+    m_model.reset();
+}
+
+QByteArray TestQueryService::nextFrame() {
+    // Сервер работает в этом же потоке: ждем, прокручивая цикл событий
+    auto complete = [this]() {
+        m_received.append(m_client->readAll());
+        return m_received.size() >= LENGTH_bytes &&
+               m_received.size() >= LENGTH_bytes + read<quint32>(m_received, 0);
+    };
+    if (!QTest::qWaitFor(complete, WAIT_ms))
+        return QByteArray();
+
+    const qsizetype length = read<quint32>(m_received, 0);
+    QByteArray body = m_received.mid(LENGTH_bytes, length);
+    m_received.remove(0, LENGTH_bytes + length);
+    return body;
+}
+
+void TestQueryService::mapInfo() {
+    m_client->write(request(42, MAP_INFO));
+
+    const QByteArray body = nextFrame();
+    QCOMPARE(body.size(), 21);
+    QCOMPARE(read<quint32>(body, 0), quint32(42));
+    QCOMPARE(read<quint8>(body, 4), STATUS_OK);
+    QCOMPARE(read<quint32>(body, 5), quint32(12));
+    QCOMPARE(read<quint32>(body, 9), quint32(5));
+    QCOMPARE(read<quint64>(body, 13), m_model->version());
+}
+
+void TestQueryService::frameSplitAcrossWrites() {
+    const QByteArray data = request(7, MAP_INFO);
+
+    // Обрыв внутри длины и внутри тела: ответ только на целый кадр
+    m_client->write(data.left(2));
+    m_client->flush();
+    QTest::qWait(50);
+    m_client->write(data.mid(2, 4));
+    m_client->flush();
+    QTest::qWait(50);
+    QCOMPARE(m_client->bytesAvailable(), qint64(0));
+
+    m_client->write(data.mid(6));
+    const QByteArray body = nextFrame();
+    QCOMPARE(read<quint32>(body, 0), quint32(7));
+    QCOMPARE(read<quint8>(body, 4), STATUS_OK);
+}
+
+void TestQueryService::pipelinedFrames() {
+    // Несколько кадров одной записью; ошибочный запрос не рвет соединение
+    QByteArray data;
+    data.append(request(1, MAP_INFO));
+    data.append(request(2, 0x7F));
+    data.append(request(3, FIND_PATH, QByteArray(3, '\0')));
+    data.append(request(4, MAP_INFO));
+    m_client->write(data);
+
+    const std::pair<quint32, quint8> expected[] = {
+        { 1, STATUS_OK }, { 2, STATUS_BAD_REQUEST }, { 3, STATUS_BAD_REQUEST }, { 4, STATUS_OK }
+    };
+    for (const auto &[id, status] : expected) {
+        const QByteArray body = nextFrame();
+        QVERIFY(body.size() >= 5);
+        QCOMPARE(read<quint32>(body, 0), id);
+        QCOMPARE(read<quint8>(body, 4), status);
+    }
+    QCOMPARE(m_client->state(), QLocalSocket::ConnectedState);
+}
+
+void TestQueryService::findPath() {
+    m_client->write(findPathRequest(9, QPoint(0, 0), QPoint(3, 0)));
+
+    const QByteArray body = nextFrame();
+    QCOMPARE(body.size(), 17);
+    QCOMPARE(read<quint32>(body, 0), quint32(9));
+    QCOMPARE(read<quint8>(body, 4), STATUS_OK);
+    QCOMPARE(read<quint16>(body, 5), quint16(0));
+    QCOMPARE(read<quint16>(body, 7), quint16(0));
+    QCOMPARE(read<quint32>(body, 9), quint32(1));
+    QCOMPARE(read<quint32>(body, 13), CompactPath::encodeRun(Direction::RIGHT, 3));
+}
+
+void TestQueryService::badFrameLengthClosesConnection_data() {
+    QTest::addColumn<quint32>("length");
+
+    QTest::newRow("oversized") << quint32(MAX_FRAME_bytes + 1);
+    QTest::newRow("huge") << quint32(0xFFFFFFFF);
+    QTest::newRow("shorter than header") << quint32(4);
+}
+
+void TestQueryService::badFrameLengthClosesConnection() {
+    QFETCH(quint32, length);
+
+    // Тело не нужно: длины достаточно, чтобы признать канал испорченным
+    QByteArray data;
+    append<quint32>(data, length);
+    m_client->write(data);
+
+    QTRY_COMPARE_WITH_TIMEOUT(m_client->state(), QLocalSocket::UnconnectedState, WAIT_ms);
+    QCOMPARE(m_client->bytesAvailable(), qint64(0));
+}
+
+QTEST_GUILESS_MAIN(TestQueryService)
+
+#include "tst_queryservice.moc"